@@ -0,0 +1,161 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+  
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifdef ARDUINO
+
+#include <B64Stream.h>
+
+// Most input per update that's sure to fit the output buffer, allowing
+// for the two bytes the context may be carrying.
+#define B64_PRINT_CHUNK (B64_STREAM_BUFFER / 4 * 3 - 2)
+
+B64EncodingPrint::B64EncodingPrint(Print &out) : out(out), head(0), tail(0) {
+  b64enc_init(&ctx);
+}
+
+// drain - pass on the characters held back in buf. Returns true once
+// they're all through, or false, with the write error set, if the
+// underlying Print stops taking them.
+bool B64EncodingPrint::drain() {
+  while (head < tail) {
+    size_t n = out.write((const uint8_t *) buf + head, tail - head);
+    if (n == 0) {
+      setWriteError();
+      return false;
+    }
+    head += n;
+  }
+  head = tail = 0;
+
+  return true;
+}
+
+size_t B64EncodingPrint::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t B64EncodingPrint::write(const uint8_t *buffer, size_t size) {
+  size_t i = 0;
+
+  if (!drain()) return 0;
+
+  // A chunk is counted as soon as it's in the context. Whatever of its
+  // encoding doesn't get through waits in buf for the next call.
+  while (i < size) {
+    size_t chunk = size - i;
+    if (chunk > B64_PRINT_CHUNK) chunk = B64_PRINT_CHUNK;
+
+    tail = b64enc_update(&ctx, (const char *) buffer + i, buf, chunk);
+    i += chunk;
+    if (!drain()) break;
+  }
+
+  return i;
+}
+
+void B64EncodingPrint::flush() {
+  drain();
+  out.flush();
+}
+
+size_t B64EncodingPrint::end() {
+  size_t n;
+
+  tail += b64enc_final(&ctx, buf + tail);
+  n = tail - head;
+  drain();
+
+  return n - (tail - head);
+}
+
+B64DecodingStream::B64DecodingStream(Stream &in, int flags)
+  : in(in), failed(false), ending(false), head(0), tail(0) {
+  b64dec_init_flags(&ctx, flags);
+}
+
+// fill - decode whatever characters the source has ready, up to one
+// buffer's worth. Never waits on the source. Once end() has been called
+// and the source is empty, finish the message. Returns true if there are
+// decoded bytes to hand out.
+bool B64DecodingStream::fill() {
+  char chars[B64_STREAM_BUFFER];
+  size_t n = 0;
+
+  if (head < tail) return true;
+  if (failed) return false;
+
+  // Leave room for the three characters the context may be carrying.
+  while (n < sizeof chars - 3 && in.available() > 0) {
+    int c = in.read();
+    if (c < 0) break;
+    chars[n++] = (char) c;
+  }
+
+  // The last one or two bytes of an unpadded group only come out here,
+  // and a group cut short is only caught here.
+  if (n == 0 && ending) {
+    ending = false;
+    int len = b64dec_final_bytes(&ctx, (char *) buf);
+    if (len < 0) {
+      failed = true;
+      return false;
+    }
+    head = 0;
+    tail = len;
+    return tail > 0;
+  }
+
+  int len = b64dec_update(&ctx, chars, (char *) buf, n);
+  if (len < 0) {
+    failed = true;
+    return false;
+  }
+  head = 0;
+  tail = len;
+
+  return tail > 0;
+}
+
+int B64DecodingStream::available() {
+  fill();
+  return tail - head;
+}
+
+int B64DecodingStream::read() {
+  if (!fill()) return -1;
+  return buf[head++];
+}
+
+int B64DecodingStream::peek() {
+  if (!fill()) return -1;
+  return buf[head];
+}
+
+size_t B64DecodingStream::write(uint8_t c) {
+  (void) c;
+  return 0;
+}
+
+void B64DecodingStream::end() {
+  ending = true;
+  fill();
+}
+
+bool B64DecodingStream::error() const {
+  return failed;
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+  
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Arduino Print and Stream adapters built on the streaming encoder and
+ * decoder. Data is encoded or decoded on its way through, using a small
+ * fixed buffer, so a large upload or download never needs to be held in
+ * RAM in full. Arduino only.
+ */
+
+#ifndef B64STREAM_H
+#define B64STREAM_H
+
+#include <Arduino.h>
+#include <b64.h>
+
+// B64_STREAM_BUFFER - size of the internal buffer in each adapter. A
+// multiple of four.
+#ifndef B64_STREAM_BUFFER
+#define B64_STREAM_BUFFER 64
+#endif
+
+/*
+ * B64EncodingPrint
+ *   A Print that base64 encodes everything written to it and passes the
+ *   characters on to another Print, e.g. Serial, a WiFiClient or a File.
+ *   Call end() when the message is complete to write out the last group
+ *   and its padding. After that, the next write starts a new message.
+ *   Characters the underlying Print doesn't take are held back and sent
+ *   ahead of the next write(), flush() or end(). A write() that can't get
+ *   them through returns 0 and sets getWriteError(), but bytes it has
+ *   already counted are never lost or encoded twice.
+ * Example:
+ *   B64EncodingPrint b64(client);
+ *   b64.write(frame, frame_len);
+ *   b64.end();
+ */
+class B64EncodingPrint : public Print {
+  public:
+    B64EncodingPrint(Print &out);
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+    // Pass on anything held back, then anything buffered by the
+    // underlying Print. Does not end the message.
+    void flush();
+
+    // Finish the message. Returns the number of characters written.
+    size_t end();
+
+  private:
+    bool drain();
+
+    Print &out;
+    b64enc_ctx ctx;
+    char buf[B64_STREAM_BUFFER + 5];  // Room for end()'s group and NULL behind a full buffer.
+    size_t head;
+    size_t tail;
+};
+
+/*
+ * B64DecodingStream
+ *   A Stream that reads base64 characters from another Stream and gives
+ *   back the decoded bytes. Pass B64_SKIPWS as flags to ignore line
+ *   breaks. A Stream can't tell running dry from reaching the end, so call
+ *   end() once the source has nothing more to give, e.g. the File is read
+ *   to the end or the client has disconnected. When the last of the
+ *   source has been decoded, the message is finished: with
+ *   B64_PAD_OPTIONAL or B64_PAD_NONE, the one or two bytes of an unpadded
+ *   last group are handed out, and input cut short partway through a group
+ *   makes error() true. After that, the next read starts a new message.
+ *   Once invalid input is seen, error() returns true and no more bytes are
+ *   returned. Read only, writes are ignored.
+ * Example:
+ *   B64DecodingStream b64(client, B64_SKIPWS);
+ *   while (client.connected() || client.available())
+ *     while (b64.available()) file.write(b64.read());
+ *   b64.end();
+ *   while (b64.available()) file.write(b64.read());
+ *   if (b64.error()) Serial.println("bad base64");
+ */
+class B64DecodingStream : public Stream {
+  public:
+    B64DecodingStream(Stream &in, int flags = 0);
+
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+
+    // The source has no more input. The message is finished as soon as
+    // the bytes already decoded have been read.
+    void end();
+
+    // True if the input so far was not valid base64, or a message finished
+    // by end() was cut short.
+    bool error() const;
+
+  private:
+    bool fill();
+
+    Stream &in;
+    b64dec_ctx ctx;
+    bool failed;
+    bool ending;
+    uint8_t buf[B64_STREAM_BUFFER / 4 * 3];
+    size_t head;
+    size_t tail;
+};
+
+#endif
@@ -15,164 +15,1311 @@
 */
 
 #include <b64.h>
+#include "b64_priv.h"
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
+#include <stdint.h>
+#include <limits.h>
+
+// B64_TABLE - where the lookup tables live. On AVR that's PROGMEM, so
+// they stay in flash instead of being copied into SRAM at startup, and are
+// read back with B64_MAP() and B64_REV(). An LPM costs one cycle more than
+// reading SRAM, so this is always on.
+//
+// B64_IRAM - with B64_USE_IRAM defined, the one-shot encode and decode
+// functions are placed in IRAM on ESP32 and ESP8266, and on ESP32 their
+// tables in DRAM as well. Then nothing they touch waits on the flash
+// cache, which misses badly while Wi-Fi or flash writes are busy. IRAM is
+// scarce, so this is opt-in, and best left without B64_PAIR_TABLE (8 KB.)
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define B64_TABLE PROGMEM
+#define B64_MAP(n) pgm_read_byte(&b64map[(n)])
+#define B64_REV(c) pgm_read_byte(&b64revmap[(uint8_t) (c)])
+#else
+#define B64_MAP(n) b64map[(n)]
+#define B64_REV(c) b64revmap[(uint8_t) (c)]
+#endif
+
+#if defined(B64_USE_IRAM) && defined(ESP_PLATFORM)
+#include <esp_attr.h>
+#define B64_IRAM IRAM_ATTR
+#define B64_TABLE DRAM_ATTR
+#elif defined(B64_USE_IRAM) && defined(ARDUINO_ARCH_ESP8266)
+#define B64_IRAM IRAM_ATTR
+#endif
+
+#ifndef B64_TABLE
+#define B64_TABLE
+#endif
+#ifndef B64_IRAM
+#define B64_IRAM
+#endif
+
+#ifdef __GNUC__
+#define B64_INLINE static inline __attribute__((always_inline))
+#define B64_ASSUME_ALIGNED(p, n) __builtin_assume_aligned((p), (n))
+#else
+#define B64_INLINE static inline
+#define B64_ASSUME_ALIGNED(p, n) (p)
+#endif
+
+// B64_BIG_ENDIAN and B64_LITTLE_ENDIAN - byte order, so characters packed
+// into a word can go down in memory order with one store. GCC and Clang
+// say which it is. Other compilers can be told with -DB64_BIG_ENDIAN or
+// -DB64_LITTLE_ENDIAN, or else the characters are packed through memory a
+// byte at a time, which is right either way.
+#if !defined(B64_BIG_ENDIAN) && !defined(B64_LITTLE_ENDIAN) && \
+    defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && defined(__ORDER_LITTLE_ENDIAN__)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define B64_BIG_ENDIAN 1
+#elif __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define B64_LITTLE_ENDIAN 1
+#endif
+#endif
 
 // b64map - 6-bit index selects the correct character from the base64 
 // 'alphabet' as described in RFC4648. Also used for decoding functions.
-const char b64map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char b64map[] B64_TABLE = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
 // b64pad - padding character, also described in RFC4648.
 const char b64pad = '=';
 
-size_t b64enclen(size_t unenc_len) {
-  size_t enc_len;
+// B64_INVALID - sentinel found in b64revmap for any character that is not
+// part of the base64 alphabet. Valid entries only ever use the low six
+// bits, so OR-ing a group of lookups and testing the top two bits catches
+// a bad character anywhere in the group.
+#define B64_INVALID 0xFF
 
-  // Padding the unencoded length by 2 for worst case makes calculating
-  // easier. If it turns out padding is not needed, integer division will
-  // drop the fractional part. The result is the correct length without any
-  // of the hassle dealing with padding.
-  unenc_len += 2;
-  
-  // Encoded is four-thirds the unencoded length. Add 1 for NULL terminator.
-  enc_len = (unenc_len / 3 * 4) + 1;
+// B64_SPACE - sentinel found in b64revmap for whitespace (space, tab, CR,
+// LF, VT and FF.) Strict decoding treats it like any other bad character,
+// because it also has the top bits set. The whitespace-tolerant decoder
+// skips it.
+#define B64_SPACE 0xFE
+
+// b64revmap - the reverse of b64map. Indexed by an encoded character, it
+// gives the 6-bit value that character represents. Generated from b64map,
+// so the two must be kept in step. Placed by B64_TABLE.
+const uint8_t b64revmap[256] B64_TABLE = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFE, 0xFE, 0xFE, 0xFE, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+  0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+  0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#ifdef B64_PAIR_TABLE
+
+// b64pairs - every two-character combination of b64map, i.e. the base64
+// encoding of every 12-bit value. Turns each group of three bytes into two
+// lookups instead of four. It costs 8 KiB of flash, so builds opt in by
+// defining B64_PAIR_TABLE. Built by the preprocessor from string literals
+// rather than spelled out, and must be kept in step with b64map.
+#define B64_PAIR_ROW(c) \
+  c "A" c "B" c "C" c "D" c "E" c "F" c "G" c "H" \
+  c "I" c "J" c "K" c "L" c "M" c "N" c "O" c "P" \
+  c "Q" c "R" c "S" c "T" c "U" c "V" c "W" c "X" \
+  c "Y" c "Z" c "a" c "b" c "c" c "d" c "e" c "f" \
+  c "g" c "h" c "i" c "j" c "k" c "l" c "m" c "n" \
+  c "o" c "p" c "q" c "r" c "s" c "t" c "u" c "v" \
+  c "w" c "x" c "y" c "z" c "0" c "1" c "2" c "3" \
+  c "4" c "5" c "6" c "7" c "8" c "9" c "+" c "/"
+
+static const char b64pairs[] B64_TABLE =
+  B64_PAIR_ROW("A") B64_PAIR_ROW("B") B64_PAIR_ROW("C") B64_PAIR_ROW("D")
+  B64_PAIR_ROW("E") B64_PAIR_ROW("F") B64_PAIR_ROW("G") B64_PAIR_ROW("H")
+  B64_PAIR_ROW("I") B64_PAIR_ROW("J") B64_PAIR_ROW("K") B64_PAIR_ROW("L")
+  B64_PAIR_ROW("M") B64_PAIR_ROW("N") B64_PAIR_ROW("O") B64_PAIR_ROW("P")
+  B64_PAIR_ROW("Q") B64_PAIR_ROW("R") B64_PAIR_ROW("S") B64_PAIR_ROW("T")
+  B64_PAIR_ROW("U") B64_PAIR_ROW("V") B64_PAIR_ROW("W") B64_PAIR_ROW("X")
+  B64_PAIR_ROW("Y") B64_PAIR_ROW("Z") B64_PAIR_ROW("a") B64_PAIR_ROW("b")
+  B64_PAIR_ROW("c") B64_PAIR_ROW("d") B64_PAIR_ROW("e") B64_PAIR_ROW("f")
+  B64_PAIR_ROW("g") B64_PAIR_ROW("h") B64_PAIR_ROW("i") B64_PAIR_ROW("j")
+  B64_PAIR_ROW("k") B64_PAIR_ROW("l") B64_PAIR_ROW("m") B64_PAIR_ROW("n")
+  B64_PAIR_ROW("o") B64_PAIR_ROW("p") B64_PAIR_ROW("q") B64_PAIR_ROW("r")
+  B64_PAIR_ROW("s") B64_PAIR_ROW("t") B64_PAIR_ROW("u") B64_PAIR_ROW("v")
+  B64_PAIR_ROW("w") B64_PAIR_ROW("x") B64_PAIR_ROW("y") B64_PAIR_ROW("z")
+  B64_PAIR_ROW("0") B64_PAIR_ROW("1") B64_PAIR_ROW("2") B64_PAIR_ROW("3")
+  B64_PAIR_ROW("4") B64_PAIR_ROW("5") B64_PAIR_ROW("6") B64_PAIR_ROW("7")
+  B64_PAIR_ROW("8") B64_PAIR_ROW("9") B64_PAIR_ROW("+") B64_PAIR_ROW("/");
+
+#undef B64_PAIR_ROW
 
-  return enc_len;
+#ifdef __AVR__
+#define B64_PAIR(dst, n) memcpy_P((dst), &b64pairs[2 * (n)], 2)
+#else
+#define B64_PAIR(dst, n) memcpy((dst), &b64pairs[2 * (n)], 2)
+#endif
+
+#endif
+
+// B64_HOOK_BLOCK - how much the streaming functions encode or decode
+// between calls to a hook. Small enough to stay in the L1 cache of any
+// target, and a multiple of three and four so only the ends of a chunk
+// ever need carrying.
+#ifndef B64_HOOK_BLOCK
+#define B64_HOOK_BLOCK 768
+#endif
+
+// b64crc32 - CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) of
+// every byte value, for b64_crc32(). That isn't an IRAM function, so the
+// table stays out of DRAM under B64_USE_IRAM and is only moved to PROGMEM
+// on AVR.
+#ifdef __AVR__
+#define B64_CRC_TABLE PROGMEM
+#define B64_CRC(n) pgm_read_dword(&b64crc32[(n)])
+#else
+#define B64_CRC_TABLE
+#define B64_CRC(n) b64crc32[(n)]
+#endif
+
+static const uint32_t b64crc32[256] B64_CRC_TABLE = {
+  0x00000000u, 0x77073096u, 0xEE0E612Cu, 0x990951BAu, 0x076DC419u, 0x706AF48Fu, 0xE963A535u, 0x9E6495A3u,
+  0x0EDB8832u, 0x79DCB8A4u, 0xE0D5E91Eu, 0x97D2D988u, 0x09B64C2Bu, 0x7EB17CBDu, 0xE7B82D07u, 0x90BF1D91u,
+  0x1DB71064u, 0x6AB020F2u, 0xF3B97148u, 0x84BE41DEu, 0x1ADAD47Du, 0x6DDDE4EBu, 0xF4D4B551u, 0x83D385C7u,
+  0x136C9856u, 0x646BA8C0u, 0xFD62F97Au, 0x8A65C9ECu, 0x14015C4Fu, 0x63066CD9u, 0xFA0F3D63u, 0x8D080DF5u,
+  0x3B6E20C8u, 0x4C69105Eu, 0xD56041E4u, 0xA2677172u, 0x3C03E4D1u, 0x4B04D447u, 0xD20D85FDu, 0xA50AB56Bu,
+  0x35B5A8FAu, 0x42B2986Cu, 0xDBBBC9D6u, 0xACBCF940u, 0x32D86CE3u, 0x45DF5C75u, 0xDCD60DCFu, 0xABD13D59u,
+  0x26D930ACu, 0x51DE003Au, 0xC8D75180u, 0xBFD06116u, 0x21B4F4B5u, 0x56B3C423u, 0xCFBA9599u, 0xB8BDA50Fu,
+  0x2802B89Eu, 0x5F058808u, 0xC60CD9B2u, 0xB10BE924u, 0x2F6F7C87u, 0x58684C11u, 0xC1611DABu, 0xB6662D3Du,
+  0x76DC4190u, 0x01DB7106u, 0x98D220BCu, 0xEFD5102Au, 0x71B18589u, 0x06B6B51Fu, 0x9FBFE4A5u, 0xE8B8D433u,
+  0x7807C9A2u, 0x0F00F934u, 0x9609A88Eu, 0xE10E9818u, 0x7F6A0DBBu, 0x086D3D2Du, 0x91646C97u, 0xE6635C01u,
+  0x6B6B51F4u, 0x1C6C6162u, 0x856530D8u, 0xF262004Eu, 0x6C0695EDu, 0x1B01A57Bu, 0x8208F4C1u, 0xF50FC457u,
+  0x65B0D9C6u, 0x12B7E950u, 0x8BBEB8EAu, 0xFCB9887Cu, 0x62DD1DDFu, 0x15DA2D49u, 0x8CD37CF3u, 0xFBD44C65u,
+  0x4DB26158u, 0x3AB551CEu, 0xA3BC0074u, 0xD4BB30E2u, 0x4ADFA541u, 0x3DD895D7u, 0xA4D1C46Du, 0xD3D6F4FBu,
+  0x4369E96Au, 0x346ED9FCu, 0xAD678846u, 0xDA60B8D0u, 0x44042D73u, 0x33031DE5u, 0xAA0A4C5Fu, 0xDD0D7CC9u,
+  0x5005713Cu, 0x270241AAu, 0xBE0B1010u, 0xC90C2086u, 0x5768B525u, 0x206F85B3u, 0xB966D409u, 0xCE61E49Fu,
+  0x5EDEF90Eu, 0x29D9C998u, 0xB0D09822u, 0xC7D7A8B4u, 0x59B33D17u, 0x2EB40D81u, 0xB7BD5C3Bu, 0xC0BA6CADu,
+  0xEDB88320u, 0x9ABFB3B6u, 0x03B6E20Cu, 0x74B1D29Au, 0xEAD54739u, 0x9DD277AFu, 0x04DB2615u, 0x73DC1683u,
+  0xE3630B12u, 0x94643B84u, 0x0D6D6A3Eu, 0x7A6A5AA8u, 0xE40ECF0Bu, 0x9309FF9Du, 0x0A00AE27u, 0x7D079EB1u,
+  0xF00F9344u, 0x8708A3D2u, 0x1E01F268u, 0x6906C2FEu, 0xF762575Du, 0x806567CBu, 0x196C3671u, 0x6E6B06E7u,
+  0xFED41B76u, 0x89D32BE0u, 0x10DA7A5Au, 0x67DD4ACCu, 0xF9B9DF6Fu, 0x8EBEEFF9u, 0x17B7BE43u, 0x60B08ED5u,
+  0xD6D6A3E8u, 0xA1D1937Eu, 0x38D8C2C4u, 0x4FDFF252u, 0xD1BB67F1u, 0xA6BC5767u, 0x3FB506DDu, 0x48B2364Bu,
+  0xD80D2BDAu, 0xAF0A1B4Cu, 0x36034AF6u, 0x41047A60u, 0xDF60EFC3u, 0xA867DF55u, 0x316E8EEFu, 0x4669BE79u,
+  0xCB61B38Cu, 0xBC66831Au, 0x256FD2A0u, 0x5268E236u, 0xCC0C7795u, 0xBB0B4703u, 0x220216B9u, 0x5505262Fu,
+  0xC5BA3BBEu, 0xB2BD0B28u, 0x2BB45A92u, 0x5CB36A04u, 0xC2D7FFA7u, 0xB5D0CF31u, 0x2CD99E8Bu, 0x5BDEAE1Du,
+  0x9B64C2B0u, 0xEC63F226u, 0x756AA39Cu, 0x026D930Au, 0x9C0906A9u, 0xEB0E363Fu, 0x72076785u, 0x05005713u,
+  0x95BF4A82u, 0xE2B87A14u, 0x7BB12BAEu, 0x0CB61B38u, 0x92D28E9Bu, 0xE5D5BE0Du, 0x7CDCEFB7u, 0x0BDBDF21u,
+  0x86D3D2D4u, 0xF1D4E242u, 0x68DDB3F8u, 0x1FDA836Eu, 0x81BE16CDu, 0xF6B9265Bu, 0x6FB077E1u, 0x18B74777u,
+  0x88085AE6u, 0xFF0F6A70u, 0x66063BCAu, 0x11010B5Cu, 0x8F659EFFu, 0xF862AE69u, 0x616BFFD3u, 0x166CCF45u,
+  0xA00AE278u, 0xD70DD2EEu, 0x4E048354u, 0x3903B3C2u, 0xA7672661u, 0xD06016F7u, 0x4969474Du, 0x3E6E77DBu,
+  0xAED16A4Au, 0xD9D65ADCu, 0x40DF0B66u, 0x37D83BF0u, 0xA9BCAE53u, 0xDEBB9EC5u, 0x47B2CF7Fu, 0x30B5FFE9u,
+  0xBDBDF21Cu, 0xCABAC28Au, 0x53B39330u, 0x24B4A3A6u, 0xBAD03605u, 0xCDD70693u, 0x54DE5729u, 0x23D967BFu,
+  0xB3667A2Eu, 0xC4614AB8u, 0x5D681B02u, 0x2A6F2B94u, 0xB40BBE37u, 0xC30C8EA1u, 0x5A05DF1Bu, 0x2D02EF8Du
+};
+
+// B64_STATS - when defined, every one-shot and streaming encode or decode
+// call is counted and timed into b64stats, and passed to the trace hook if
+// one is set. Otherwise B64_STATS_BEGIN() and B64_STATS_END() compile to
+// nothing. Cycles come from rdtsc on x86 and ccount on Xtensa (ESP32,
+// ESP8266, the same counter as ESP.getCycleCount()), and are 0 elsewhere.
+#ifdef B64_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+typedef uint64_t b64_cycles_t;
+#define B64_CYCLES() ((b64_cycles_t) __rdtsc())
+#elif defined(__XTENSA__)
+typedef uint32_t b64_cycles_t;
+static inline b64_cycles_t b64_ccount(void) {
+  b64_cycles_t c;
+  __asm__ __volatile__("rsr %0, ccount" : "=a"(c));
+  return c;
 }
+#define B64_CYCLES() b64_ccount()
+#else
+typedef uint32_t b64_cycles_t;
+#define B64_CYCLES() ((b64_cycles_t) 0)
+#endif
 
-int b64enc(char *unenc, char *enc, size_t unenc_len) {
-  unsigned char buffer[4];  // Temp storage for mapping three bytes to four characters.
+// B64_STAT_ADD - add to a counter without losing counts to other cores,
+// where the target has the atomics to do it cheaply.
+#if defined(__GNUC__) && !defined(__AVR__)
+#define B64_STAT_ADD(field, n) __atomic_fetch_add(&(field), (n), __ATOMIC_RELAXED)
+#else
+#define B64_STAT_ADD(field, n) ((field) += (n))
+#endif
+
+static b64_stats b64stats;
+static b64_trace b64trace;
+static void *b64trace_arg;
+
+// b64_record - count one call and hand it to the trace hook.
+static void B64_IRAM b64_record(b64_op op, size_t in_len, size_t out_len, b64_status status, b64_cycles_t cycles) {
+  if (op == B64_OP_ENCODE) {
+    B64_STAT_ADD(b64stats.enc_calls, 1);
+    B64_STAT_ADD(b64stats.enc_bytes, in_len);
+    B64_STAT_ADD(b64stats.enc_cycles, cycles);
+  }
+  else {
+    B64_STAT_ADD(b64stats.dec_calls, 1);
+    B64_STAT_ADD(b64stats.dec_chars, in_len);
+    B64_STAT_ADD(b64stats.dec_cycles, cycles);
+    if (status != B64_OK) B64_STAT_ADD(b64stats.rejected[status], 1);
+  }
+
+  if (b64trace) {
+    b64_event event = {op, in_len, out_len, status, cycles};
+    b64trace(b64trace_arg, &event);
+  }
+}
+
+#define B64_STATS_BEGIN() b64_cycles_t b64_t0 = B64_CYCLES()
+#define B64_STATS_END(op, in_len, out_len, status) \
+  b64_record((op), (in_len), (out_len), (status), (b64_cycles_t) (B64_CYCLES() - b64_t0))
+#define B64_STATS_REJECT(status) B64_STAT_ADD(b64stats.rejected[(status)], 1)
+
+#else
+
+#define B64_STATS_BEGIN()
+#define B64_STATS_END(op, in_len, out_len, status) ((void) 0)
+#define B64_STATS_REJECT(status) ((void) 0)
+
+#endif
+
+size_t B64_IRAM b64enclen(size_t unenc_len) {
+  size_t groups;
+
+  // Every three bytes, and any one or two left over, make a group of four
+  // characters. Counting groups first, rather than adding 2 to round up,
+  // means lengths near SIZE_MAX can't wrap round to a small result.
+  groups = unenc_len / 3 + (unenc_len %3 != 0);
+  if (groups > (SIZE_MAX - 1) / 4) return 0;
+
+  // Encoded is four characters per group. Add 1 for NULL terminator.
+  return groups * 4 + 1;
+}
+
+// B64_WORD64 - set on targets with 64-bit registers, where six bytes are
+// encoded at a time instead of three.
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#define B64_WORD64 1
+#endif
+
+// b64enc_quad - encode one group of three bytes, already gathered into the
+// low 24 bits of a word, into four characters returned packed in a word in
+// memory order. Written so a store of the result puts the characters down
+// in one go.
+B64_INLINE uint32_t b64enc_quad(uint32_t n) {
+  uint32_t q;
+
+#ifdef B64_PAIR_TABLE
+  uint16_t hi;
+  uint16_t lo;
+  B64_PAIR(&hi, n >> 12);
+  B64_PAIR(&lo, n & 0xFFF);
+#if defined(B64_BIG_ENDIAN)
+  q = (uint32_t) hi << 16 | lo;
+#elif defined(B64_LITTLE_ENDIAN)
+  q = (uint32_t) lo << 16 | hi;
+#else
+  uint16_t pairs[2] = { hi, lo };
+  memcpy(&q, pairs, 4);
+#endif
+#else
+  uint32_t c0 = (unsigned char) B64_MAP(n >> 18);
+  uint32_t c1 = (unsigned char) B64_MAP(n >> 12 & 0x3F);
+  uint32_t c2 = (unsigned char) B64_MAP(n >> 6 & 0x3F);
+  uint32_t c3 = (unsigned char) B64_MAP(n & 0x3F);
+#if defined(B64_BIG_ENDIAN)
+  q = c0 << 24 | c1 << 16 | c2 << 8 | c3;
+#elif defined(B64_LITTLE_ENDIAN)
+  q = c3 << 24 | c2 << 16 | c1 << 8 | c0;
+#else
+  unsigned char chars[4] = { (unsigned char) c0, (unsigned char) c1, (unsigned char) c2, (unsigned char) c3 };
+  memcpy(&q, chars, 4);
+#endif
+#endif
+
+  return q;
+}
+
+// b64enc_words - the scalar group loop. Each group is loaded into a
+// register once and the sextets are picked out with shifts. Output goes
+// out a word at a time. Strict-alignment cores (Xtensa, Cortex-M0) can
+// only do that as one store when the output is word aligned, so the loop
+// is instantiated for both cases and the check is made once per call.
+B64_INLINE size_t b64enc_words(const unsigned char *unenc, char *enc, size_t unenc_len, int aligned) {
+  size_t i = 0;
+  size_t j = 0;
+
+#ifdef B64_WORD64
+  for (; i+6<=unenc_len; i+=6, j+=8) {
+    uint64_t n = (uint64_t) unenc[i] << 40 | (uint64_t) unenc[i+1] << 32 |
+                 (uint64_t) unenc[i+2] << 24 | (uint64_t) unenc[i+3] << 16 |
+                 (uint64_t) unenc[i+4] << 8 | unenc[i+5];
+    uint64_t hi = b64enc_quad((uint32_t) (n >> 24));
+    uint64_t lo = b64enc_quad((uint32_t) n & 0xFFFFFF);
+#if defined(B64_BIG_ENDIAN)
+    uint64_t q = hi << 32 | lo;
+    memcpy(enc + j, &q, 8);
+#elif defined(B64_LITTLE_ENDIAN)
+    uint64_t q = lo << 32 | hi;
+    memcpy(enc + j, &q, 8);
+#else
+    uint32_t q[2] = { (uint32_t) hi, (uint32_t) lo };
+    memcpy(enc + j, q, 8);
+#endif
+  }
+#endif
+
+  for (; i<unenc_len; i+=3, j+=4) {
+    uint32_t n = (uint32_t) unenc[i] << 16 | (uint32_t) unenc[i+1] << 8 | unenc[i+2];
+    uint32_t q = b64enc_quad(n);
+    if (aligned) memcpy(B64_ASSUME_ALIGNED(enc + j, 4), &q, 4);
+    else memcpy(enc + j, &q, 4);
+  }
+
+  return j;
+}
+
+// b64enc_blocks - encode whole groups of three bytes into groups of four
+// characters. unenc_len must be a multiple of three. Shared by the one-shot
+// and streaming encoders. Returns the number of characters written.
+size_t B64_IRAM b64enc_blocks(const unsigned char *unenc, char *enc, size_t unenc_len) {
+
+  // Let a vector kernel take the bulk of the input, if there is one. The
+  // word loop handles anything it leaves, or everything without SIMD. Input
+  // too short for any kernel skips the call through the kernel table.
+#ifdef B64_SIMD
+  size_t i = unenc_len >= B64_SIMD_ENC_MIN ? b64enc_simd(unenc, enc, unenc_len) : 0;
+#else
+  size_t i = 0;
+#endif
+  size_t j = i / 3 * 4;
+
+  if (((uintptr_t) (enc + j) & 3) == 0) {
+    return j + b64enc_words(unenc + i, enc + j, unenc_len - i, 1);
+  }
+  return j + b64enc_words(unenc + i, enc + j, unenc_len - i, 0);
+}
+
+// b64enc_tail - encode the one or two bytes left over after the whole
+// groups, adding padding to fill out the last group of four. Returns the
+// number of characters written (0 or 4.) Both cases take the same path: a
+// missing second byte is masked to zero, the group is encoded as if it
+// were whole, then padding is laid over the characters it doesn't fill
+// and the four go out in one store.
+static size_t B64_IRAM b64enc_tail(const unsigned char *unenc, char *enc, size_t remainder) {
+  uint32_t two;
+  uint32_t keep;
+  uint32_t q;
+
+  if (remainder == 0) return 0;
+
+  // unenc[two] is the second byte if there is one, otherwise the first
+  // again, which is always safe to read.
+  two = (uint32_t) remainder >> 1;
+  q = b64enc_quad((uint32_t) unenc[0] << 16 | (uint32_t) (unenc[two] & -two) << 8);
+
+  // Characters are in memory order, so which bytes of the word hold the
+  // last two depends on the byte order.
+#if defined(B64_BIG_ENDIAN)
+  keep = 0xFFFF0000u | (0x0000FF00u & -two);
+#elif defined(B64_LITTLE_ENDIAN)
+  keep = 0x0000FFFFu | (0x00FF0000u & -two);
+#else
+  unsigned char mask[4] = { 0xFF, 0xFF, (unsigned char) -two, 0 };
+  memcpy(&keep, mask, 4);
+#endif
+  q = (q & keep) | ((uint32_t) (unsigned char) b64pad * 0x01010101u & ~keep);
+  memcpy(enc, &q, 4);
+
+  return 4;
+}
+
+size_t B64_IRAM b64enc_bytes(const uint8_t *unenc, char *enc, size_t unenc_len) {
+  B64_STATS_BEGIN();
 
   // Any input not evenly divisible by three requires padding at the end.
   // Determining what remainder exists after dividing by three helps when
   // dealing with those special cases. 
-  int remainder = unenc_len %3;
+  size_t remainder = unenc_len %3;
   
-  // Loop through unencoded characters in sets of three at a time. Any one or
-  // two characters remaining are dealt with at the end to properly determine
+  // Encode unencoded characters in sets of three at a time. Any one or two
+  // characters remaining are dealt with at the end to properly determine
   // their padding.
-  int i = 0;
-  int j = 0;
-  for (i=0; i<unenc_len - remainder; i+=3) {  // Minus padding remainder.
-
-    // Take three bytes of eight bits and map onto four chars of six bits.
-    // E.g. ABCDEFGH IJKLMNOP QRSTUVWX => 00ABCDEF 00GHIJKL 00MNOPQR 00STUVWX
-    buffer[0] = unenc[i] >> 2;
-    buffer[1] = (unenc[i] & 0B00000011) << 4 | unenc[i+1] >> 4;
-    buffer[2] = (unenc[i+1] & 0B00001111) << 2 | unenc[i+2] >> 6;
-    buffer[3] = unenc[i+2] & 0B00111111;
-
-    // Map the six-bit bytes onto the ASCII characters used in base64.
-    enc[j++] = b64map[buffer[0]];
-    enc[j++] = b64map[buffer[1]];
-    enc[j++] = b64map[buffer[2]];
-    enc[j++] = b64map[buffer[3]];
-  }
-
-  // The remaining characters are handled differently, because there could
-  // be padding. The ammount of padding depends upon if there are one or two
-  // characters left over.
-  switch (remainder) {
-    case 2:
-      buffer[0] = unenc[i] >> 2;
-      buffer[1] = (unenc[i] & 0B00000011) << 4 | unenc[i+1] >> 4;
-      buffer[2] = (unenc[i+1] & 0B00001111) << 2 | unenc[i+2] >> 6;
-      enc[j++] = b64map[buffer[0]];
-      enc[j++] = b64map[buffer[1]];
-      enc[j++] = b64map[buffer[2]];
-      enc[j++] = b64pad;
-      break;
-    case 1:
-      buffer[0] = unenc[i] >> 2;
-      buffer[1] = (unenc[i] & 0B00000011) << 4;
-      enc[j++] = b64map[buffer[0]];
-      enc[j++] = b64map[buffer[1]];
-      enc[j++] = b64pad;
-      enc[j++] = b64pad;
-      break;
-  }
+  size_t j = b64enc_blocks(unenc, enc, unenc_len - remainder);
+  j += b64enc_tail(unenc + unenc_len - remainder, enc + j, remainder);
 
   // Finish with a NULL terminator since the encoded result is a string.
   enc[j] = '\0';
+
+  B64_STATS_END(B64_OP_ENCODE, unenc_len, j, B64_OK);
  
   return j;
 }
 
-size_t b64declen(char * enc, size_t enc_len) {
+int B64_IRAM b64enc(char *unenc, char *enc, size_t unenc_len) {
+  return b64enc_bytes((const uint8_t *) unenc, enc, unenc_len);
+}
+
+size_t b64enclen_batch(const b64_span *in, size_t count, size_t *offsets) {
+  size_t total = 0;
+
+  // Kept to plain arithmetic with no early exits so the compiler can
+  // vectorize it.
+  for (size_t k=0; k<count; k++) {
+    if (offsets) offsets[k] = total;
+    total += (in[k].len / 3 + (in[k].len %3 != 0)) * 4 + 1;
+  }
+  if (offsets) offsets[count] = total;
+
+  return total;
+}
+
+size_t b64enc_batch(const b64_span *in, size_t count, char *arena, size_t *offsets) {
+  size_t j = 0;
+
+  // Straight into the inner loops, without going back through the public
+  // wrappers for every message.
+  for (size_t k=0; k<count; k++) {
+    const unsigned char *unenc = (const unsigned char *) in[k].ptr;
+    size_t remainder = in[k].len %3;
+    B64_STATS_BEGIN();
+
+    if (offsets) offsets[k] = j;
+    j += b64enc_blocks(unenc, arena + j, in[k].len - remainder);
+    j += b64enc_tail(unenc + in[k].len - remainder, arena + j, remainder);
+    arena[j++] = '\0';
+
+    // Counted per message, the same as b64dec_batch().
+    B64_STATS_END(B64_OP_ENCODE, in[k].len, b64enclen(in[k].len) - 1, B64_OK);
+  }
+  if (offsets) offsets[count] = j;
+
+  return j;
+}
+
+size_t b64enclen_wrap(size_t unenc_len, size_t line_len, int flags) {
+  size_t chars = b64enclen(unenc_len) - 1;
+  size_t breaks;
+  size_t width = flags & B64_WRAP_CRLF ? 2 : 1;
+
+  // Lines hold whole groups of four, so breaks never split a group.
+  if (line_len == 0 || line_len %4 != 0 || chars == SIZE_MAX) return 0;
+
+  // A break goes between each pair of lines, and after the last one too
+  // if asked for.
+  breaks = chars == 0 ? 0 : (chars - 1) / line_len;
+  if ((flags & B64_WRAP_FINAL) && chars > 0) breaks++;
+  if (breaks > (SIZE_MAX - 1 - chars) / width) return 0;
+
+  return chars + breaks * width + 1;
+}
+
+size_t b64enc_wrap(char *unenc, char *enc, size_t unenc_len, size_t line_len, int flags) {
+  const unsigned char *in = (const unsigned char *) unenc;
+  size_t line_bytes = line_len / 4 * 3;
+  size_t i = 0;
+  size_t j = 0;
+  size_t remainder;
+
+  if (line_len == 0 || line_len %4 != 0) return 0;
+  B64_STATS_BEGIN();
+
+  // Whole lines, each followed by a break only if more is to come.
+  while (unenc_len - i > line_bytes) {
+    j += b64enc_blocks(in + i, enc + j, line_bytes);
+    i += line_bytes;
+    if (flags & B64_WRAP_CRLF) enc[j++] = '\r';
+    enc[j++] = '\n';
+  }
+
+  // The last line, full or not, ends like an ordinary message. Done here
+  // rather than through b64enc() so the call is counted once, in full.
+  remainder = (unenc_len - i) %3;
+  j += b64enc_blocks(in + i, enc + j, unenc_len - i - remainder);
+  j += b64enc_tail(in + unenc_len - remainder, enc + j, remainder);
+
+  if ((flags & B64_WRAP_FINAL) && unenc_len > 0) {
+    if (flags & B64_WRAP_CRLF) enc[j++] = '\r';
+    enc[j++] = '\n';
+  }
+  enc[j] = '\0';
+
+  B64_STATS_END(B64_OP_ENCODE, unenc_len, j, B64_OK);
+
+  return j;
+}
+
+size_t b64enc_updatelen(size_t unenc_len) {
+
+  // Up to two bytes may be carried in from the previous update, so the
+  // worst case is every input byte plus two more ending up in full groups.
+  return (unenc_len / 3 + (unenc_len %3 != 0)) * 4;
+}
+
+void b64enc_init(b64enc_ctx *ctx) {
+  ctx->carry_len = 0;
+  ctx->hook = NULL;
+  ctx->hook_arg = NULL;
+}
+
+void b64enc_set_hook(b64enc_ctx *ctx, b64_sink hook, void *arg) {
+  ctx->hook = hook;
+  ctx->hook_arg = arg;
+}
+
+// b64enc_step - encode one chunk for b64enc_update().
+static size_t b64enc_step(b64enc_ctx *ctx, const char *unenc, char *enc, size_t unenc_len) {
+  const unsigned char *in = (const unsigned char *) unenc;
+  size_t j = 0;
+
+  // Finish any group started by an earlier update before moving on to the
+  // new input. If there still isn't enough for a group, keep carrying.
+  if (ctx->carry_len > 0) {
+    unsigned char group[3];
+    size_t need = 3 - ctx->carry_len;
+
+    if (unenc_len < need) {
+      memcpy(ctx->carry + ctx->carry_len, in, unenc_len);
+      ctx->carry_len += unenc_len;
+      return 0;
+    }
+    memcpy(group, ctx->carry, ctx->carry_len);
+    memcpy(group + ctx->carry_len, in, need);
+    j = b64enc_blocks(group, enc, 3);
+    in += need;
+    unenc_len -= need;
+  }
+
+  // Encode every whole group, then hold on to the zero to two bytes left
+  // over until the next update (or the final call) supplies the rest.
+  size_t remainder = unenc_len %3;
+  j += b64enc_blocks(in, enc + j, unenc_len - remainder);
+  memcpy(ctx->carry, in + unenc_len - remainder, remainder);
+  ctx->carry_len = remainder;
+
+  return j;
+}
+
+size_t b64enc_update(b64enc_ctx *ctx, const char *unenc, char *enc, size_t unenc_len) {
+  size_t j = 0;
+  B64_STATS_BEGIN();
+
+  if (!ctx->hook) {
+    j = b64enc_step(ctx, unenc, enc, unenc_len);
+  }
+  else {
+
+    // With a hook, take the input a block at a time, so the hook and the
+    // encoder both read each block while it's still in cache.
+    for (size_t i=0; i<unenc_len; i+=B64_HOOK_BLOCK) {
+      size_t n = unenc_len - i < B64_HOOK_BLOCK ? unenc_len - i : B64_HOOK_BLOCK;
+
+      ctx->hook(ctx->hook_arg, (const uint8_t *) unenc + i, n);
+      j += b64enc_step(ctx, unenc + i, enc + j, n);
+    }
+  }
+
+  B64_STATS_END(B64_OP_ENCODE, unenc_len, j, B64_OK);
+
+  return j;
+}
+
+size_t b64enc_final(b64enc_ctx *ctx, char *enc) {
+  size_t j = b64enc_tail(ctx->carry, enc, ctx->carry_len);
+
+  enc[j] = '\0';
+  ctx->carry_len = 0;
+
+  return j;
+}
+
+int b64enc_inplace(char *buf, size_t unenc_len) {
+  unsigned char *in = (unsigned char *) buf;
+  unsigned char tail[2];
+  size_t remainder = unenc_len %3;
+  size_t groups = unenc_len / 3;
+  size_t j = groups * 4;
+
+  // The output is bigger than the input, so work from the back. Group k
+  // reads bytes 3k to 3k+2 and writes characters 4k to 4k+3. Everything it
+  // overwrites either belongs to a group already done, or to itself and
+  // was loaded first. The one or two leftover bytes go first of all.
+  memcpy(tail, in + groups * 3, remainder);
+  j += b64enc_tail(tail, buf + j, remainder);
+  buf[j] = '\0';
+
+  for (size_t k=groups; k>0; k--) {
+    size_t i = (k - 1) * 3;
+    uint32_t n = (uint32_t) in[i] << 16 | (uint32_t) in[i+1] << 8 | in[i+2];
+    uint32_t q = b64enc_quad(n);
+    memcpy(buf + (k - 1) * 4, &q, 4);
+  }
+
+  return j;
+}
+
+size_t B64_IRAM b64declen_span(const char *enc, size_t enc_len) {
   size_t dec_len;
-  
-  // Any C-style string not ending with a NULL timinator is invalid.
-  // Rememeber to subtract one from the length due to zero indexing.
-  if (enc[enc_len - 1] != '\0') return 0;
-  
+
+  // A NULL terminator is allowed, but not required.
+  if (enc_len > 0 && enc[enc_len - 1] == '\0') enc_len--;
+
   // Even a single byte encoded to base64 results in a for character
   // string (two chars, two padding.) Anything less is invalid.
   if (enc_len < 4) return 0;
 
-  // Padded base64 string lengths are always divisible by four (after
-  // subtracting the NULL terminator) Otherwise, they're not vaild.
-  if ((enc_len - 1) %4 != 0) return 0;
+  // Padded base64 string lengths are always divisible by four. Otherwise,
+  // they're not vaild.
+  if (enc_len %4 != 0) return 0;
 
   // Maximum decoded length is three-fourths the encoded length.
-  dec_len = ((enc_len - 1) / 4 * 3);
+  dec_len = (enc_len / 4 * 3);
 
-  // Padding characters don't count for decoded length.
-  if (enc[enc_len - 2] == b64pad) dec_len--;
-  if (enc[enc_len - 3] == b64pad) dec_len--;
+  // Padding characters don't count for decoded length. The second to last
+  // character is only padding if the last one is too, the same rule the
+  // decoder uses.
+  size_t pad_d = enc[enc_len - 1] == b64pad;
+  size_t pad_c = enc[enc_len - 2] == b64pad && pad_d;
 
-  return dec_len;
+  return dec_len - pad_d - pad_c;
 }
 
-int b64dec(char *enc, char *dec, size_t enc_len) {
-  unsigned char buffer[4];  // Temp storage for mapping three bytes to four characters.
+size_t B64_IRAM b64declen(char * enc, size_t enc_len) {
+  
+  // Any C-style string not ending with a NULL timinator is invalid.
+  // Rememeber to subtract one from the length due to zero indexing.
+  if (enc_len == 0 || enc[enc_len - 1] != '\0') return 0;
 
-  // base64 encoded input should always be evenly divisible by four, due to
-  // padding characters. If not, it's an error. Note: because base64 is held
-  // in a C-style string, there's the NULL terminator to subtract first.
-  if ((enc_len - 1) %4 != 0) return 0;
+  return b64declen_span(enc, enc_len);
+}
 
-  int padded = 0;
-  if (enc[enc_len - 2] == b64pad) padded++;
-  if (enc[enc_len - 3] == b64pad) padded++;
+size_t b64declen_flags(const char *enc, size_t enc_len, int flags) {
+
+  // Whitespace can be anywhere, so the most there could be will have to do.
+  if (flags & B64_SKIPWS) return b64dec_updatelen(enc_len);
+  if (!(flags & (B64_PAD_OPTIONAL | B64_PAD_NONE))) return b64declen_span(enc, enc_len);
+
+  if (enc_len > 0 && enc[enc_len - 1] == '\0') enc_len--;
+
+  // Count padding off first, where it's allowed, then the length of the
+  // last group alone says how many bytes it holds: two characters make
+  // one byte and three make two. One on its own can't be valid.
+  if (!(flags & B64_PAD_NONE) && enc_len %4 == 0 && enc_len >= 4) {
+    if (enc[enc_len - 1] == b64pad) enc_len--;
+    if (enc[enc_len - 1] == b64pad) enc_len--;
+  }
+  if (enc_len %4 == 1) return 0;
 
-  // Loop through encoded characters in sets of four at a time, because there
-  // are four encoded characters for every three decoded characters. But, if
-  // its not evenly divisible by four leave the remaining as a special case.
-  int i = 0;
-  int j = 0;
+  return enc_len / 4 * 3 + (enc_len %4 ? enc_len %4 - 1 : 0);
+}
 
-  //Serial.print("Looping until i < ");
-  //Serial.println(enc_len - padded - 4);
+// b64dec_blocks - decode whole groups of four characters, none of which may
+// be padding. Stops at the first group holding a character outside the
+// base64 alphabet, leaving the caller to decide what to do about it.
+// Returns the number of characters consumed, always a multiple of four.
+// Three bytes are written for every four characters consumed.
+size_t B64_IRAM b64dec_blocks(const char *enc, unsigned char *dec, size_t enc_len) {
+  unsigned char buffer[4];  // Temp storage for mapping three bytes to four characters.
 
-  for (i=0; i<enc_len - padded - 4; i+=4) {
+  // A vector kernel, if there is one, takes the bulk of the input. If it
+  // stops early on a bad character, the loop below finds the exact group.
+#ifdef B64_SIMD
+  size_t i = enc_len >= B64_SIMD_DEC_MIN ? b64dec_simd(enc, dec, enc_len) : 0;
+#else
+  size_t i = 0;
+#endif
+  size_t j = i / 4 * 3;
 
-    //Serial.println(i);
+  for (; i+4<=enc_len; i+=4) {
 
     // Take four chars of six bits and map onto four bytes of eight bits.
     // E.g. 00ABCDEF 00GHIJKL 00MNOPQR 00STUVWX => ABCDEFGH IJKLMNOP QRSTUVWX
-    buffer[0] = strchr(b64map, enc[i]) - b64map;
-    buffer[1] = strchr(b64map, enc[i+1]) - b64map;
-    buffer[2] = strchr(b64map, enc[i+2]) - b64map;
-    buffer[3] = strchr(b64map, enc[i+3]) - b64map;
+    buffer[0] = B64_REV(enc[i]);
+    buffer[1] = B64_REV(enc[i+1]);
+    buffer[2] = B64_REV(enc[i+2]);
+    buffer[3] = B64_REV(enc[i+3]);
+    if ((buffer[0] | buffer[1] | buffer[2] | buffer[3]) & 0xC0) break;
     dec[j++] = buffer[0] << 2 | buffer[1] >> 4;
     dec[j++] = buffer[1] << 4 | buffer[2] >> 2;
     dec[j++] = buffer[2] << 6 | buffer[3];
   }
 
-  // Take care of special case.
-  switch (padded) {
-    case 1:
-      buffer[0] = strchr(b64map, enc[i]) - b64map;
-      buffer[1] = strchr(b64map, enc[i+1]) - b64map;
-      buffer[2] = strchr(b64map, enc[i+2]) - b64map;
-      dec[j++] = buffer[0] << 2 | buffer[1] >> 4;
-      dec[j++] = buffer[1] << 4 | buffer[2] >> 2;
+  return i;
+}
+
+// b64dec_where - find the first character in a group that isn't part of
+// the alphabet, and say whether it was misplaced padding or just a bad
+// character.
+static b64_status B64_IRAM b64dec_where(const char *enc, size_t offset, size_t count, size_t *err_pos) {
+  size_t k;
+
+  for (k=0; k<count-1; k++) {
+    if (B64_REV(enc[offset + k]) & 0xC0) break;
+  }
+  if (err_pos) *err_pos = offset + k;
+
+  return enc[offset + k] == b64pad ? B64_ERR_PAD : B64_ERR_CHAR;
+}
+
+// b64dec_oneshot - one-shot decode for b64dec_status() and b64dec_flags(),
+// with the padding rule given by flags.
+static b64_status B64_IRAM b64dec_oneshot(const char *enc, char *dec, size_t enc_len, int flags, size_t *dec_len, size_t *err_pos) {
+  unsigned char *out = (unsigned char *) dec;
+  unsigned char buffer[3];
+
+  if (dec_len) *dec_len = 0;
+
+  // A NULL terminator is allowed, but not required.
+  if (enc_len > 0 && enc[enc_len - 1] == '\0') enc_len--;
+
+  // Padded base64 should always be evenly divisible by four. Without
+  // padding the last group may be two or three characters, but a single
+  // character can't hold a whole byte. Otherwise, the last group was cut
+  // short.
+  size_t tail = enc_len %4;
+  if (tail == 1 || (tail != 0 && !(flags & (B64_PAD_OPTIONAL | B64_PAD_NONE)))) {
+    if (err_pos) *err_pos = enc_len - tail;
+    return B64_ERR_TRUNC;
+  }
+  if (enc_len == 0) return B64_OK;
+
+  int padded = 0;
+  if (tail == 0 && !(flags & B64_PAD_NONE)) {
+    if (enc[enc_len - 1] == b64pad) padded++;
+    if (enc[enc_len - 2] == b64pad && padded) padded++;
+  }
+
+  // Decode encoded characters in sets of four at a time, because there are
+  // four encoded characters for every three decoded characters. But, if the
+  // last set has padding or is short, leave it as a special case.
+  // Characters are checked as they're decoded. There's no separate pass to
+  // validate.
+  size_t full = enc_len - tail;
+  if (padded) full -= 4;
+
+  size_t i = b64dec_blocks(enc, out, full);
+  size_t j = i / 4 * 3;
+  if (dec_len) *dec_len = j;
+  if (i < full) return b64dec_where(enc, i, 4, err_pos);
+
+  // Take care of special case. A group of three characters, padded or
+  // not, makes two bytes, and a group of two makes one.
+  switch (padded ? 4 - padded : (int) tail) {
+    case 3:
+      buffer[0] = B64_REV(enc[i]);
+      buffer[1] = B64_REV(enc[i+1]);
+      buffer[2] = B64_REV(enc[i+2]);
+      if ((buffer[0] | buffer[1] | buffer[2]) & 0xC0) return b64dec_where(enc, i, 3, err_pos);
+      out[j++] = buffer[0] << 2 | buffer[1] >> 4;
+      out[j++] = buffer[1] << 4 | buffer[2] >> 2;
       break;
     case 2:
-      buffer[0] = strchr(b64map, enc[i]) - b64map;
-      buffer[1] = strchr(b64map, enc[i+1]) - b64map;
-      dec[j++] = buffer[0] << 2 | buffer[1] >> 4;
+      buffer[0] = B64_REV(enc[i]);
+      buffer[1] = B64_REV(enc[i+1]);
+      if ((buffer[0] | buffer[1]) & 0xC0) return b64dec_where(enc, i, 2, err_pos);
+      out[j++] = buffer[0] << 2 | buffer[1] >> 4;
       break;
   }
-  
+
+  if (dec_len) *dec_len = j;
+
+  return B64_OK;
+}
+
+// b64dec_run - b64dec_oneshot() with its call counted, for B64_STATS.
+static b64_status B64_IRAM b64dec_run(const char *enc, char *dec, size_t enc_len, int flags, size_t *dec_len, size_t *err_pos) {
+  size_t len;
+  B64_STATS_BEGIN();
+
+  b64_status status = b64dec_oneshot(enc, dec, enc_len, flags, &len, err_pos);
+  if (dec_len) *dec_len = len;
+
+  B64_STATS_END(B64_OP_DECODE, enc_len, len, status);
+
+  return status;
+}
+
+b64_status B64_IRAM b64dec_status(const char *enc, char *dec, size_t enc_len, size_t *dec_len, size_t *err_pos) {
+  return b64dec_run(enc, dec, enc_len, 0, dec_len, err_pos);
+}
+
+size_t b64dec_flags(const char *enc, uint8_t *dec, size_t enc_len, int flags) {
+  size_t dec_len;
+
+  // Skipping whitespace is a job for the streaming decoder, which is still
+  // a single pass.
+  if (flags & B64_SKIPWS) {
+    b64dec_ctx ctx;
+    size_t n;
+    int last;
+
+    b64dec_init_flags(&ctx, flags);
+    if (b64dec_update_status(&ctx, enc, (char *) dec, enc_len, &n) != B64_OK) {
+      b64dec_final(&ctx);
+      return 0;
+    }
+    last = b64dec_final_bytes(&ctx, (char *) dec + n);
+    if (last < 0) return 0;
+    return n + last;
+  }
+
+  if (b64dec_run(enc, (char *) dec, enc_len, flags, &dec_len, NULL) != B64_OK) return 0;
+
+  return dec_len;
+}
+
+size_t B64_IRAM b64dec_bytes(const char *enc, uint8_t *dec, size_t enc_len) {
+  size_t dec_len;
+
+  if (b64dec_status(enc, (char *) dec, enc_len, &dec_len, NULL) != B64_OK) return 0;
+
+  return dec_len;
+}
+
+int B64_IRAM b64dec_span(const char *enc, char *dec, size_t enc_len) {
+  return b64dec_bytes(enc, (uint8_t *) dec, enc_len);
+}
+
+int B64_IRAM b64dec(char *enc, char *dec, size_t enc_len) {
+
+  // Because base64 is held in a C-style string, there's the NULL
+  // terminator to subtract first.
+  if (enc_len == 0) return 0;
+
+  return b64dec_span(enc, dec, enc_len - 1);
+}
+
+size_t b64declen_batch(const b64_span *in, size_t count) {
+  size_t total = 0;
+
+  for (size_t k=0; k<count; k++) total += in[k].len / 4 * 3;
+
+  return total;
+}
+
+size_t b64dec_batch_status(const b64_span *in, size_t count, uint8_t *arena, size_t *offsets, b64_status *status) {
+  size_t failed = 0;
+  size_t j = 0;
+
+  for (size_t k=0; k<count; k++) {
+    size_t dec_len;
+    b64_status result = b64dec_status((const char *) in[k].ptr, (char *) arena + j, in[k].len, &dec_len, NULL);
+
+    if (offsets) offsets[k] = j;
+    if (status) status[k] = result;
+    if (result != B64_OK) {
+      failed++;
+      continue;
+    }
+    j += dec_len;
+  }
+  if (offsets) offsets[count] = j;
+
+  return failed;
+}
+
+size_t b64dec_batch(const b64_span *in, size_t count, uint8_t *arena, size_t *offsets) {
+  return b64dec_batch_status(in, count, arena, offsets, NULL);
+}
+
+int b64dec_inplace(char *buf, size_t len) {
+
+  // Decoding only ever shrinks the data and works front to back. Every
+  // group, and every vector in the kernels, is read before its output is
+  // written, and the output never gets ahead of the input, so there's
+  // nothing to do but point both sides at the same buffer.
+  return b64dec(buf, buf, len);
+}
+
+size_t b64dec_updatelen(size_t enc_len) {
+
+  // Up to three characters of a partial group may be carried in from the
+  // previous update.
+  return (enc_len / 4 + (enc_len %4 != 0)) * 3;
+}
+
+void b64dec_init_flags(b64dec_ctx *ctx, int flags) {
+  ctx->quad_len = 0;
+  ctx->padded = 0;
+  ctx->done = 0;
+  ctx->error = 0;
+  ctx->flags = flags;
+  ctx->hook = NULL;
+  ctx->hook_arg = NULL;
+}
+
+void b64dec_set_hook(b64dec_ctx *ctx, b64_sink hook, void *arg) {
+  ctx->hook = hook;
+  ctx->hook_arg = arg;
+}
+
+void b64dec_init(b64dec_ctx *ctx) {
+  b64dec_init_flags(ctx, 0);
+}
+
+// b64dec_flush - decode the complete group held in the context, minding
+// any padding. Returns the number of bytes written.
+static size_t b64dec_flush(b64dec_ctx *ctx, unsigned char *dec) {
+  const unsigned char *q = ctx->quad;
+  size_t j = 0;
+
+  dec[j++] = q[0] << 2 | q[1] >> 4;
+  if (ctx->padded < 2) dec[j++] = q[1] << 4 | q[2] >> 2;
+  if (ctx->padded < 1) dec[j++] = q[2] << 6 | q[3];
+
+  // Padding can only ever close out the very last group.
+  if (ctx->padded) ctx->done = 1;
+  ctx->quad_len = 0;
+
+  return j;
+}
+
+// b64dec_step - decode one chunk for b64dec_update(). Sets *end if a NULL
+// terminator cut it short. Returns the number of bytes written, or 0 with
+// ctx->error set if the input is invalid.
+static size_t b64dec_step(b64dec_ctx *ctx, const char *enc, char *dec, size_t enc_len, int *end) {
+  unsigned char *out = (unsigned char *) dec;
+  size_t i = 0;
+  size_t j = 0;
+  char c = 0;
+
+  if (ctx->error) return 0;
+
+  while (i < enc_len) {
+
+    // Whenever the context is on a group boundary, decode as many whole
+    // groups as possible straight from the input. That leaves only the
+    // ragged ends of each chunk, and padding, for the slower path below.
+    if (ctx->quad_len == 0 && !ctx->done) {
+      size_t n = b64dec_blocks(enc + i, out + j, (enc_len - i) / 4 * 4);
+      i += n;
+      j += n / 4 * 3;
+      if (i == enc_len) break;
+    }
+
+    // One character at a time, carrying a partial group across updates.
+    // A NULL terminator ends the input, so strings can be passed whole.
+    unsigned char value;
+
+    c = enc[i++];
+
+    if (c == '\0') {
+      *end = 1;
+      break;
+    }
+
+    // Line breaks and other whitespace are dropped here when asked for.
+    // The groups between them still go through the fast path above.
+    if ((ctx->flags & B64_SKIPWS) && B64_REV(c) == B64_SPACE) continue;
+    if (ctx->done) goto invalid;
+    if (c == b64pad) {
+
+      // Padding may only fill the last one or two places of a group.
+      if (ctx->quad_len < 2 || (ctx->flags & B64_PAD_NONE)) goto invalid;
+      ctx->padded++;
+      value = 0;
+    }
+    else {
+      value = B64_REV(c);
+      if ((value & 0xC0) || ctx->padded) goto invalid;
+    }
+
+    ctx->quad[ctx->quad_len++] = value;
+    if (ctx->quad_len == 4) j += b64dec_flush(ctx, out + j);
+  }
+
+  return j;
+
+invalid:
+  ctx->error = c == b64pad ? B64_ERR_PAD : B64_ERR_CHAR;
+  return 0;
+}
+
+b64_status b64dec_update_status(b64dec_ctx *ctx, const char *enc, char *dec, size_t enc_len, size_t *dec_len) {
+  int end = 0;
+  size_t j = 0;
+
+  if (dec_len) *dec_len = 0;
+
+  // Once input has been rejected, the rest of the message has nothing to
+  // decode and nothing to count.
+  if (ctx->error) return (b64_status) ctx->error;
+
+  B64_STATS_BEGIN();
+
+  if (!ctx->hook) {
+    j = b64dec_step(ctx, enc, dec, enc_len, &end);
+  }
+  else {
+
+    // With a hook, decode a block at a time and pass each one on straight
+    // away, while its bytes are still in cache.
+    for (size_t i=0; i<enc_len && !end && !ctx->error; i+=B64_HOOK_BLOCK) {
+      size_t n = enc_len - i < B64_HOOK_BLOCK ? enc_len - i : B64_HOOK_BLOCK;
+      size_t written = b64dec_step(ctx, enc + i, dec + j, n, &end);
+
+      if (written > 0) ctx->hook(ctx->hook_arg, (const uint8_t *) dec + j, written);
+      j += written;
+    }
+  }
+  if (ctx->error) j = 0;
+
+  B64_STATS_END(B64_OP_DECODE, enc_len, j, (b64_status) ctx->error);
+
+  if (dec_len) *dec_len = j;
+
+  return (b64_status) ctx->error;
+}
+
+int b64dec_update(b64dec_ctx *ctx, const char *enc, char *dec, size_t enc_len) {
+  size_t j;
+
+  // The count has to fit the int returned.
+  if (b64dec_updatelen(enc_len) > INT_MAX) return -1;
+  if (b64dec_update_status(ctx, enc, dec, enc_len, &j) != B64_OK) return -1;
+
+  return (int) j;
+}
+
+int b64dec_final(b64dec_ctx *ctx) {
+  b64_sink hook = ctx->hook;
+  void *hook_arg = ctx->hook_arg;
+  int result = 0;
+
+  // A group left unfinished means the message was cut short. The flags
+  // and hook stay for the next message.
+  if (ctx->error || ctx->quad_len != 0) result = -1;
+  if (!ctx->error && ctx->quad_len != 0) B64_STATS_REJECT(B64_ERR_TRUNC);
+  b64dec_init_flags(ctx, ctx->flags);
+  b64dec_set_hook(ctx, hook, hook_arg);
+
+  return result;
+}
+
+int b64dec_final_bytes(b64dec_ctx *ctx, char *dec) {
+  size_t j = 0;
+
+  // Without padding, the message can end on two or three characters of a
+  // group. Decode them as though the padding were there.
+  if (!ctx->error && !ctx->padded && ctx->quad_len >= 2 &&
+      (ctx->flags & (B64_PAD_OPTIONAL | B64_PAD_NONE))) {
+    ctx->padded = 4 - ctx->quad_len;
+    ctx->quad[3] = 0;
+    if (ctx->quad_len == 2) ctx->quad[2] = 0;
+    j = b64dec_flush(ctx, (unsigned char *) dec);
+    if (ctx->hook) ctx->hook(ctx->hook_arg, (const uint8_t *) dec, j);
+  }
+  if (b64dec_final(ctx) != 0) return -1;
+
+  return j;
+}
+
+size_t b64dec_ws(const char *enc, char *dec, size_t enc_len) {
+  b64dec_ctx ctx;
+  size_t dec_len;
+
+  // A single update over the whole input. The context only comes into
+  // play at line breaks, so this is still one pass.
+  b64dec_init_flags(&ctx, B64_SKIPWS);
+  b64dec_update_status(&ctx, enc, dec, enc_len, &dec_len);
+  if (b64dec_final(&ctx) != 0) return 0;
+
+  return dec_len;
+}
+
+// b64_cursor - the next place to write in a list of output segments.
+typedef struct b64_cursor {
+  const b64_iov *iov;
+  size_t count;
+  size_t seg;
+  size_t off;
+} b64_cursor;
+
+// b64_cursor_room - room left in the current segment, moving on past any
+// that are full. 0 once every segment is.
+static size_t b64_cursor_room(b64_cursor *cur) {
+  while (cur->seg < cur->count && cur->off == cur->iov[cur->seg].len) {
+    cur->seg++;
+    cur->off = 0;
+  }
+
+  return cur->seg < cur->count ? cur->iov[cur->seg].len - cur->off : 0;
+}
+
+static char *b64_cursor_ptr(const b64_cursor *cur) {
+  return (char *) cur->iov[cur->seg].base + cur->off;
+}
+
+// b64_cursor_copy - spread a few characters or bytes from a bounce buffer
+// over however many segments they need. Returns -1 if they run out.
+static int b64_cursor_copy(b64_cursor *cur, const char *src, size_t len) {
+  while (len > 0) {
+    size_t room = b64_cursor_room(cur);
+    size_t n = len < room ? len : room;
+    if (room == 0) return -1;
+    memcpy(b64_cursor_ptr(cur), src, n);
+    cur->off += n;
+    src += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+// b64_iov_len - total length of a list of segments.
+static size_t b64_iov_len(const b64_iov *iov, size_t count) {
+  size_t len = 0;
+
+  for (size_t k=0; k<count; k++) len += iov[k].len;
+
+  return len;
+}
+
+size_t b64enc_iov(const b64_iov *in, size_t in_count, const b64_iov *out, size_t out_count) {
+  b64_cursor cur = { out, out_count, 0, 0 };
+  b64enc_ctx ctx;
+  char bounce[8];
+  size_t unenc_len = b64_iov_len(in, in_count);
+  size_t j = 0;
+
+  if (b64enclen(unenc_len) == 0 || b64enclen(unenc_len) - 1 > b64_iov_len(out, out_count)) return 0;
+  B64_STATS_BEGIN();
+
+  // Encode straight into the segment whenever the output is sure to fit,
+  // allowing for two bytes carried over. Only the few characters either
+  // side of a boundary go through the bounce buffer. Steps rather than
+  // updates, so the call is counted once.
+  b64enc_init(&ctx);
+  for (size_t k=0; k<in_count; k++) {
+    const char *unenc = (const char *) in[k].base;
+    size_t left = in[k].len;
+
+    while (left > 0) {
+      size_t n = b64_cursor_room(&cur) / 4 * 3;
+      size_t written;
+
+      if (n > 2) {
+        n = n - 2 < left ? n - 2 : left;
+        written = b64enc_step(&ctx, unenc, b64_cursor_ptr(&cur), n);
+        cur.off += written;
+      }
+      else {
+        n = left < 3 ? left : 3;
+        written = b64enc_step(&ctx, unenc, bounce, n);
+        b64_cursor_copy(&cur, bounce, written);
+      }
+      unenc += n;
+      left -= n;
+      j += written;
+    }
+  }
+
+  size_t written = b64enc_final(&ctx, bounce);
+  b64_cursor_copy(&cur, bounce, written);
+  j += written;
+
+  B64_STATS_END(B64_OP_ENCODE, unenc_len, j, B64_OK);
+
   return j;
 }
+
+size_t b64dec_iov(const b64_iov *in, size_t in_count, const b64_iov *out, size_t out_count, int flags) {
+  b64_cursor cur = { out, out_count, 0, 0 };
+  b64dec_ctx ctx;
+  char bounce[4];
+  size_t j = 0;
+  int end = 0;
+  size_t written;
+  int last;
+  B64_STATS_BEGIN();
+
+  // The same as b64enc_iov(), allowing for three characters carried over.
+  b64dec_init_flags(&ctx, flags);
+  for (size_t k=0; k<in_count; k++) {
+    const char *enc = (const char *) in[k].base;
+    size_t left = in[k].len;
+
+    while (left > 0) {
+      size_t n = b64_cursor_room(&cur) / 3 * 4;
+
+      if (n > 3) {
+        n = n - 3 < left ? n - 3 : left;
+        written = b64dec_step(&ctx, enc, b64_cursor_ptr(&cur), n, &end);
+        if (ctx.error) goto fail;
+        cur.off += written;
+      }
+      else {
+        n = left < 4 ? left : 4;
+        written = b64dec_step(&ctx, enc, bounce, n, &end);
+        if (ctx.error || b64_cursor_copy(&cur, bounce, written) != 0) goto fail;
+      }
+      enc += n;
+      left -= n;
+      j += written;
+    }
+  }
+
+  // An unpadded message can end part way through a group.
+  last = b64dec_final_bytes(&ctx, bounce);
+  if (last < 0 || b64_cursor_copy(&cur, bounce, last) != 0) goto fail;
+  j += last;
+
+  B64_STATS_END(B64_OP_DECODE, b64_iov_len(in, in_count), j, B64_OK);
+
+  return j;
+
+fail:
+  // A message cut short was already counted as rejected by
+  // b64dec_final(), which leaves the context clear.
+  B64_STATS_END(B64_OP_DECODE, b64_iov_len(in, in_count), 0, (b64_status) ctx.error);
+  return 0;
+}
+
+uint32_t b64_crc32(uint32_t crc, const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *) data;
+
+  crc = ~crc;
+  for (size_t i=0; i<len; i++) crc = B64_CRC((crc ^ p[i]) & 0xFF) ^ crc >> 8;
+
+  return ~crc;
+}
+
+void b64_crc32_hook(void *arg, const uint8_t *data, size_t len) {
+  uint32_t *crc = (uint32_t *) arg;
+
+  *crc = b64_crc32(*crc, data, len);
+}
+
+int b64_get_stats(b64_stats *stats) {
+#ifdef B64_STATS
+  *stats = b64stats;
+  return 0;
+#else
+  memset(stats, 0, sizeof *stats);
+  return -1;
+#endif
+}
+
+void b64_reset_stats(void) {
+#ifdef B64_STATS
+  memset(&b64stats, 0, sizeof b64stats);
+#endif
+}
+
+int b64_set_trace(b64_trace trace, void *arg) {
+#ifdef B64_STATS
+  b64trace_arg = arg;
+  b64trace = trace;
+  return 0;
+#else
+  (void) trace;
+  (void) arg;
+  return -1;
+#endif
+}
@@ -14,10 +14,11 @@
   OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#ifndef b64.h
-#define b64.h
+#ifndef B64_H
+#define B64_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #ifdef __cplusplus
@@ -34,7 +35,8 @@ extern "C" {
  *    'sizeof unencoded' will work.
  * Returns:
  *   size_t number or characters required for base64 encoded message plus a
- *   NULL terminator. Suitable for array declarations such as:
+ *   NULL terminator, or 0 if that's more than a size_t can hold. Suitable
+ *   for array declarations such as:
  *   'char output[b64enclen(sizeof unencoded)]'
  */
 size_t b64enclen(size_t unenc_len);
@@ -55,6 +57,205 @@ size_t b64enclen(size_t unenc_len);
  */
 int b64enc(char *unenc, char *enc, size_t unenc_len);
 
+/*
+ * b64enc_bytes
+ *   Same as b64enc(), but takes the input as unsigned bytes and returns a
+ *   size_t, so binary data doesn't need casting and inputs over 2 GB are
+ *   handled correctly. b64enc() is kept for existing code.
+ * Parameters:
+ *   unenc - pointer to the bytes to be encoded.
+ *   enc - pointer to a character array of b64enclen(unenc_len) bytes.
+ *   unenc_len - number of bytes pointed to by unenc.
+ * Returns:
+ *   size_t number of characters written, not counting the NULL
+ *   terminator.
+ */
+size_t b64enc_bytes(const uint8_t *unenc, char *enc, size_t unenc_len);
+
+/*
+ * b64_span
+ *   A pointer and length pair, one message in a batch.
+ */
+typedef struct b64_span {
+  const void *ptr;
+  size_t len;
+} b64_span;
+
+/*
+ * b64enclen_batch
+ *   Size an arena for b64enc_batch(). Optionally fills in where each
+ *   message will start, the same offsets b64enc_batch() produces.
+ * Parameters:
+ *   in - array of messages to be encoded.
+ *   count - number of messages.
+ *   offsets - NULL, or an array of count + 1 entries.
+ * Returns:
+ *   size_t number of characters the whole batch needs, NULL terminators
+ *   included.
+ */
+size_t b64enclen_batch(const b64_span *in, size_t count, size_t *offsets);
+
+/*
+ * b64enc_batch
+ *   Encode many messages in one call, one after the other into a single
+ *   arena, each with its own NULL terminator. Saves the per-call overhead
+ *   when there are lots of small messages, as with MQTT or telemetry.
+ * Parameters:
+ *   in - array of messages to be encoded.
+ *   count - number of messages.
+ *   arena - character array of b64enclen_batch(in, count, NULL) bytes.
+ *   offsets - NULL, or an array of count + 1 entries. Entry k is set to
+ *     where message k starts in the arena, and the last to the total.
+ * Returns:
+ *   size_t number of characters written, NULL terminators included.
+ */
+size_t b64enc_batch(const b64_span *in, size_t count, char *arena, size_t *offsets);
+
+/*
+ * Line wrapping flags, for b64enclen_wrap() and b64enc_wrap().
+ *   B64_WRAP_CRLF - end lines with CR LF, as MIME does, instead of LF.
+ *   B64_WRAP_FINAL - end the last line with a break as well, as PEM does.
+ */
+#define B64_WRAP_CRLF 0x01
+#define B64_WRAP_FINAL 0x02
+
+/*
+ * b64enclen_wrap
+ *   Same as b64enclen(), but for output broken into lines by
+ *   b64enc_wrap(). The result is exact, including the line breaks and
+ *   the NULL terminator.
+ * Parameters:
+ *   unenc_len - the length of the unencoded data.
+ *   line_len - characters per line, not counting the break. Must be a
+ *     multiple of four, e.g. 76 for MIME or 64 for PEM.
+ *   flags - line wrapping flags OR-ed together, or 0.
+ * Returns:
+ *   size_t number of characters required, or 0 if line_len is invalid
+ *   or the result is more than a size_t can hold.
+ */
+size_t b64enclen_wrap(size_t unenc_len, size_t line_len, int flags);
+
+/*
+ * b64enc_wrap
+ *   Same as b64enc(), but breaks the output into lines of line_len
+ *   characters as it goes, so MIME and PEM bodies don't need a second
+ *   copy to insert line breaks. b64enclen_wrap() should be used to size
+ *   the output.
+ * Parameters:
+ *   unenc - pointer to a character array with the contents to be encoded.
+ *   enc - pointer to a byte array that will be filled with base64 output.
+ *   unenc_len - length of the data pointed to by unenc.
+ *   line_len - characters per line, not counting the break. Must be a
+ *     multiple of four.
+ *   flags - line wrapping flags OR-ed together, or 0.
+ * Returns:
+ *   size_t number of characters written, including line breaks but not
+ *   the NULL terminator, or 0 if line_len is invalid.
+ */
+size_t b64enc_wrap(char *unenc, char *enc, size_t unenc_len, size_t line_len, int flags);
+
+/*
+ * b64_sink
+ *   Callback that is handed bytes as they pass through: the input to a
+ *   streaming encoder, the output of a streaming decoder, or the output of
+ *   a pipe. Called in order, one block at a time.
+ */
+typedef void (*b64_sink)(void *arg, const uint8_t *data, size_t len);
+
+/*
+ * b64enc_ctx
+ *   State for encoding a message that arrives in pieces. Carries the zero
+ *   to two bytes that didn't make up a whole group of three between calls
+ *   to b64enc_update(). Treat the members as private.
+ */
+typedef struct b64enc_ctx {
+  unsigned char carry[2];
+  size_t carry_len;
+  b64_sink hook;
+  void *hook_arg;
+} b64enc_ctx;
+
+/*
+ * b64enc_init
+ *   Prepare an encoder context for a new message. Must be called before
+ *   the first b64enc_update().
+ * Parameters:
+ *   ctx - pointer to the encoder context.
+ */
+void b64enc_init(b64enc_ctx *ctx);
+
+/*
+ * b64enc_set_hook
+ *   Have every byte given to b64enc_update() passed to a hook as well,
+ *   such as b64_crc32_hook() or a SHA-256 update. Input is taken a block
+ *   at a time, hook first and then encoder, so it's read from memory once
+ *   for both. Stays set for following messages until b64enc_init().
+ * Parameters:
+ *   ctx - pointer to an encoder context set up by b64enc_init().
+ *   hook - function to call, or NULL for none.
+ *   arg - passed through to hook.
+ */
+void b64enc_set_hook(b64enc_ctx *ctx, b64_sink hook, void *arg);
+
+/*
+ * b64enc_updatelen
+ *   Given the length of a chunk about to be passed to b64enc_update(),
+ *   calculate the most characters that call can write. Useful for sizing
+ *   a fixed output window once, up front.
+ * Parameters:
+ *   unenc_len - the length of the chunk.
+ * Returns:
+ *   size_t maximum number of characters written. No NULL terminator is
+ *   included, because b64enc_update() doesn't write one.
+ */
+size_t b64enc_updatelen(size_t unenc_len);
+
+/*
+ * b64enc_update
+ *   Encode the next chunk of a message. Chunks may be any length. Whole
+ *   groups of three bytes are encoded right away, and any remainder is
+ *   kept in the context until the next call. Output from successive calls
+ *   joins up into one base64 string, so it can be sent on as it's made.
+ * Parameters:
+ *   ctx - pointer to an encoder context set up by b64enc_init().
+ *   unenc - pointer to the chunk to be encoded.
+ *   enc - pointer to a character array with room for at least
+ *     b64enc_updatelen(unenc_len) characters.
+ *   unenc_len - length of the chunk pointed to by unenc.
+ * Returns:
+ *   size_t number of characters written. Output is not NULL terminated.
+ */
+size_t b64enc_update(b64enc_ctx *ctx, const char *unenc, char *enc, size_t unenc_len);
+
+/*
+ * b64enc_final
+ *   Finish a message by encoding whatever bytes are still carried in the
+ *   context, along with any padding, then NULL terminate. The context is
+ *   left ready for a new message.
+ * Parameters:
+ *   ctx - pointer to the encoder context.
+ *   enc - pointer to a character array with room for 5 characters (four
+ *     base64 characters plus the NULL terminator.)
+ * Returns:
+ *   size_t number of characters written, not counting the NULL terminator.
+ */
+size_t b64enc_final(b64enc_ctx *ctx, char *enc);
+
+/*
+ * b64enc_inplace
+ *   Encode the bytes at the front of a buffer to base64 in the same
+ *   buffer, so there is no need for a second one to hold the output. The
+ *   buffer must be big enough for the encoded result, i.e.
+ *   b64enclen(unenc_len) bytes.
+ * Parameters:
+ *   buf - pointer to the buffer, holding the data to encode at the front.
+ *   unenc_len - length of the data to encode.
+ * Returns:
+ *   Integer representing the number of characters written, not counting
+ *   the NULL terminator.
+ */
+int b64enc_inplace(char *buf, size_t unenc_len);
+
 /*
  * b64declen
  *   Given a base64 encoded string and its length, perform a number of 
@@ -74,9 +275,575 @@ size_t b64declen(char * enc, size_t enc_len);
  *   Given a base64 encoded string and its length, fill the decoded array
  *   with the decoded binary representation of the input. b64declen() should
  *   be used to properly size the array intended to hold the encoded output.
+ * Parameters:
+ *   enc - pointer to the base64 encoded string.
+ *   dec - pointer to a byte array that will be filled with decoded output.
+ *   enc_len - the length of the encoded string (i.e. 'sizeof enc'.)
+ * Returns:
+ *   Integer representing the number of bytes decoded, or 0 if the input
+ *   is not a valid base64 string (bad length or a character outside the
+ *   base64 alphabet.)
  */
 int b64dec(char *enc, char *dec, size_t enc_len);
 
+/*
+ * b64declen_span
+ *   Same as b64declen(), but for base64 that isn't necessarily held in a
+ *   C-style string, such as a network buffer or a memory-mapped file.
+ *   enc_len is the exact number of characters. A NULL terminator at the
+ *   end is allowed but not needed.
+ * Parameters:
+ *   enc - a pointer to the base64 encoded characters.
+ *   enc_len - the number of characters, with or without a terminator.
+ * Returns:
+ *   size_t number of characters required for the decoded message or
+ *   0 in the case of invalid base64.
+ */
+size_t b64declen_span(const char *enc, size_t enc_len);
+
+/*
+ * b64dec_span
+ *   Same as b64dec(), but takes the exact number of characters rather
+ *   than the size of a C-style string, so input needn't be copied just to
+ *   add a terminator. A NULL terminator at the end is allowed but not
+ *   needed.
+ * Parameters:
+ *   enc - pointer to the base64 encoded characters.
+ *   dec - pointer to a byte array that will be filled with decoded output.
+ *   enc_len - the number of characters, with or without a terminator.
+ * Returns:
+ *   Integer representing the number of bytes decoded, or 0 if the input
+ *   is not valid base64.
+ */
+int b64dec_span(const char *enc, char *dec, size_t enc_len);
+
+/*
+ * b64dec_bytes
+ *   Same as b64dec_span(), but writes unsigned bytes and returns a
+ *   size_t, so outputs over 2 GB are handled correctly.
+ * Parameters:
+ *   enc - pointer to the base64 encoded characters.
+ *   dec - pointer to a byte array of b64declen_span(enc, enc_len) bytes.
+ *   enc_len - the number of characters, with or without a terminator.
+ * Returns:
+ *   size_t number of bytes decoded, or 0 if the input is not valid base64.
+ */
+size_t b64dec_bytes(const char *enc, uint8_t *dec, size_t enc_len);
+
+/*
+ * b64declen_flags
+ *   Same as b64declen_span(), for the padding rules of b64dec_flags().
+ *   Unpadded input gets an exact length from how many characters the
+ *   last group has, so it needn't be padded out into a new buffer first.
+ * Parameters:
+ *   enc - pointer to the base64 encoded characters.
+ *   enc_len - the number of characters, with or without a terminator.
+ *   flags - decoder flags OR-ed together, or 0 for padding required.
+ * Returns:
+ *   size_t number of bytes the input decodes to, or 0 if the length can't
+ *   be valid. With B64_SKIPWS, the most it could decode to.
+ */
+size_t b64declen_flags(const char *enc, size_t enc_len, int flags);
+
+/*
+ * b64dec_flags
+ *   Same as b64dec_bytes(), with decoder flags. B64_PAD_OPTIONAL and
+ *   B64_PAD_NONE decode a short last group of two or three characters
+ *   in place, and B64_SKIPWS skips whitespace.
+ * Parameters:
+ *   enc - pointer to the base64 encoded characters.
+ *   dec - pointer to a byte array of b64declen_flags(enc, enc_len, flags)
+ *     bytes.
+ *   enc_len - the number of characters, with or without a terminator.
+ *   flags - decoder flags OR-ed together, or 0.
+ * Returns:
+ *   size_t number of bytes decoded, or 0 if the input is not valid.
+ */
+size_t b64dec_flags(const char *enc, uint8_t *dec, size_t enc_len, int flags);
+
+/*
+ * b64_status
+ *   Result of b64dec_status().
+ *   B64_OK - the input was valid and has been decoded.
+ *   B64_ERR_CHAR - a character outside the base64 alphabet.
+ *   B64_ERR_PAD - padding somewhere other than the end of the last group.
+ *   B64_ERR_TRUNC - the input doesn't end on a whole group of four.
+ */
+typedef enum b64_status {
+  B64_OK = 0,
+  B64_ERR_CHAR,
+  B64_ERR_PAD,
+  B64_ERR_TRUNC
+} b64_status;
+
+/*
+ * b64dec_status
+ *   Validate and decode in a single pass, reporting exactly what was
+ *   wrong with bad input and where. Meant for untrusted input, where a
+ *   bare 0 from b64dec() isn't enough to go on. An empty string is valid
+ *   and decodes to nothing.
+ * Parameters:
+ *   enc - pointer to the base64 encoded characters.
+ *   dec - pointer to a byte array with room for b64declen_span(enc,
+ *     enc_len) bytes.
+ *   enc_len - the number of characters, with or without a terminator.
+ *   dec_len - if not NULL, set to the number of bytes written. On error
+ *     that's however many were decoded before the problem was found.
+ *   err_pos - if not NULL, set on error to the offset of the offending
+ *     character, or of the start of an incomplete last group.
+ * Returns:
+ *   b64_status, B64_OK if the whole input was valid.
+ */
+b64_status b64dec_status(const char *enc, char *dec, size_t enc_len, size_t *dec_len, size_t *err_pos);
+
+/*
+ * b64declen_batch
+ *   Size an arena for b64dec_batch(). This is an upper bound that doesn't
+ *   look at the data.
+ * Parameters:
+ *   in - array of base64 messages.
+ *   count - number of messages.
+ * Returns:
+ *   size_t most bytes the whole batch can decode to.
+ */
+size_t b64declen_batch(const b64_span *in, size_t count);
+
+/*
+ * b64dec_batch
+ *   Decode many base64 messages in one call, one after the other into a
+ *   single arena. Messages are exact lengths, with or without
+ *   terminators. A message that isn't valid decodes to nothing and the
+ *   rest carry on. Use b64dec_batch_status() to tell which.
+ * Parameters:
+ *   in - array of base64 messages.
+ *   count - number of messages.
+ *   arena - byte array of b64declen_batch(in, count) bytes.
+ *   offsets - NULL, or an array of count + 1 entries. Message k is
+ *     decoded to arena[offsets[k]] up to arena[offsets[k + 1]].
+ * Returns:
+ *   size_t number of messages that were not valid base64.
+ */
+size_t b64dec_batch(const b64_span *in, size_t count, uint8_t *arena, size_t *offsets);
+
+/*
+ * b64dec_batch_status
+ *   Same as b64dec_batch(), also recording how each message went, so an
+ *   invalid message can be told from an empty one.
+ * Parameters:
+ *   in - array of base64 messages.
+ *   count - number of messages.
+ *   arena - byte array of b64declen_batch(in, count) bytes.
+ *   offsets - NULL, or an array of count + 1 entries, as for
+ *     b64dec_batch().
+ *   status - NULL, or an array of count entries. Entry k is set to the
+ *     b64dec_status() result for message k.
+ * Returns:
+ *   size_t number of messages that were not valid base64.
+ */
+size_t b64dec_batch_status(const b64_span *in, size_t count, uint8_t *arena, size_t *offsets, b64_status *status);
+
+/*
+ * b64dec_inplace
+ *   Decode a base64 string, writing the decoded bytes over the front of
+ *   the same buffer. Decoded data is always shorter than the string, so no
+ *   second buffer is needed. If the string turns out to be invalid, the
+ *   buffer contents are undefined.
+ * Parameters:
+ *   buf - pointer to the base64 encoded string.
+ *   len - the length of the encoded string (i.e. 'sizeof buf'.)
+ * Returns:
+ *   Integer representing the number of bytes decoded, or 0 if the input
+ *   is not a valid base64 string.
+ */
+int b64dec_inplace(char *buf, size_t len);
+
+/*
+ * b64dec_ctx
+ *   State for decoding a base64 string that arrives in pieces. Carries a
+ *   partial group of up to three characters between calls to
+ *   b64dec_update(), along with what padding has been seen. Treat the
+ *   members as private.
+ */
+typedef struct b64dec_ctx {
+  unsigned char quad[4];
+  size_t quad_len;
+  int padded;
+  int done;
+  int error;
+  int flags;
+  b64_sink hook;
+  void *hook_arg;
+} b64dec_ctx;
+
+/*
+ * Decoder flags, for b64dec_init_flags(), b64dec_flags() and
+ * b64declen_flags().
+ *   B64_SKIPWS - ignore spaces, tabs, CR and LF anywhere in the input, as
+ *     found in line-wrapped MIME and PEM bodies.
+ *   B64_PAD_OPTIONAL - accept input with or without '=' padding, so the
+ *     last group may be two or three characters long.
+ *   B64_PAD_NONE - input must not be padded at all, as in JWT and
+ *     WebAuthn. '=' is treated as a bad character.
+ */
+#define B64_SKIPWS 0x01
+#define B64_PAD_OPTIONAL 0x02
+#define B64_PAD_NONE 0x04
+
+/*
+ * b64dec_init
+ *   Prepare a decoder context for a new message. Must be called before
+ *   the first b64dec_update().
+ * Parameters:
+ *   ctx - pointer to the decoder context.
+ */
+void b64dec_init(b64dec_ctx *ctx);
+
+/*
+ * b64dec_init_flags
+ *   Same as b64dec_init(), but with decoder flags (B64_SKIPWS.)
+ * Parameters:
+ *   ctx - pointer to the decoder context.
+ *   flags - decoder flags OR-ed together, or 0.
+ */
+void b64dec_init_flags(b64dec_ctx *ctx, int flags);
+
+/*
+ * b64dec_set_hook
+ *   Have every byte b64dec_update() decodes passed to a hook as well, such
+ *   as b64_crc32_hook() or a SHA-256 update. Decoding goes a block at a
+ *   time, with each block handed to the hook while it's still in cache,
+ *   so checking the data costs no second pass. Stays set for following
+ *   messages until b64dec_init().
+ * Parameters:
+ *   ctx - pointer to a decoder context set up by b64dec_init().
+ *   hook - function to call, or NULL for none.
+ *   arg - passed through to hook.
+ */
+void b64dec_set_hook(b64dec_ctx *ctx, b64_sink hook, void *arg);
+
+/*
+ * b64dec_updatelen
+ *   Given the length of a chunk about to be passed to b64dec_update(),
+ *   calculate the most bytes that call can write.
+ * Parameters:
+ *   enc_len - the length of the chunk.
+ * Returns:
+ *   size_t maximum number of bytes written.
+ */
+size_t b64dec_updatelen(size_t enc_len);
+
+/*
+ * b64dec_update
+ *   Decode the next chunk of a base64 string. Chunks may be any length and
+ *   need not be NULL terminated. A group of four split across chunks is
+ *   kept in the context until the rest arrives. Padding is decoded as soon
+ *   as it completes the final group. A NULL character ends the chunk, so a
+ *   C-style string can be passed with its terminator.
+ * Parameters:
+ *   ctx - pointer to a decoder context set up by b64dec_init().
+ *   enc - pointer to the chunk of base64 characters.
+ *   dec - pointer to a byte array with room for at least
+ *     b64dec_updatelen(enc_len) bytes.
+ *   enc_len - length of the chunk pointed to by enc.
+ * Returns:
+ *   Integer number of bytes written, or -1 if the input is not valid
+ *   base64. Once an error is returned, later updates return -1 as well.
+ *   A chunk that could decode to more than INT_MAX bytes is refused with
+ *   -1 before anything is decoded; b64dec_update_status() takes those.
+ */
+int b64dec_update(b64dec_ctx *ctx, const char *enc, char *dec, size_t enc_len);
+
+/*
+ * b64dec_update_status
+ *   Same as b64dec_update(), for chunks of any size, with the number of
+ *   bytes written passed back separately from the outcome.
+ * Parameters:
+ *   ctx - pointer to a decoder context set up by b64dec_init().
+ *   enc - pointer to the chunk of base64 characters.
+ *   dec - pointer to a byte array with room for at least
+ *     b64dec_updatelen(enc_len) bytes.
+ *   enc_len - length of the chunk pointed to by enc.
+ *   dec_len - set to the number of bytes written. May be NULL.
+ * Returns:
+ *   B64_OK, or why the input is not valid base64. Once an error is
+ *   returned, later updates return it as well.
+ */
+b64_status b64dec_update_status(b64dec_ctx *ctx, const char *enc, char *dec, size_t enc_len, size_t *dec_len);
+
+/*
+ * b64dec_final
+ *   Finish a message. Checks nothing was left over in a partial group and
+ *   leaves the context ready for a new message.
+ * Parameters:
+ *   ctx - pointer to the decoder context.
+ * Returns:
+ *   Integer 0 if the whole message was valid, or -1 if it was invalid or
+ *   cut short.
+ */
+int b64dec_final(b64dec_ctx *ctx);
+
+/*
+ * b64dec_final_bytes
+ *   Same as b64dec_final(), but with B64_PAD_OPTIONAL or B64_PAD_NONE a
+ *   message may end part way through a group, and the one or two bytes in
+ *   it are written out here.
+ * Parameters:
+ *   ctx - pointer to the decoder context.
+ *   dec - pointer to a byte array with room for 2 bytes.
+ * Returns:
+ *   Integer number of bytes written (0 to 2), or -1 if the message was
+ *   invalid or cut short.
+ */
+int b64dec_final_bytes(b64dec_ctx *ctx, char *dec);
+
+/*
+ * b64dec_ws
+ *   Decode base64 that may be broken into lines or otherwise contain
+ *   whitespace, such as a MIME attachment or PEM certificate body, without
+ *   stripping it out first. Whitespace is skipped as the input is decoded.
+ * Parameters:
+ *   enc - pointer to the base64 encoded characters.
+ *   dec - pointer to a byte array with room for at least
+ *     b64dec_updatelen(enc_len) bytes.
+ *   enc_len - the number of characters, with or without a terminator.
+ * Returns:
+ *   size_t number of bytes decoded, or 0 if the input is not valid
+ *   base64.
+ */
+size_t b64dec_ws(const char *enc, char *dec, size_t enc_len);
+
+/*
+ * b64_iov
+ *   One segment of a scatter/gather list, laid out like a POSIX struct
+ *   iovec, so a chain of lwIP pbufs or a readv() array can be described
+ *   without copying it together first.
+ */
+typedef struct b64_iov {
+  void *base;
+  size_t len;
+} b64_iov;
+
+/*
+ * b64enc_iov
+ *   Encode the bytes in a list of input segments, taken in order as one
+ *   message, across a list of output segments. Groups are free to
+ *   straddle segments on either side. No NULL terminator is written.
+ * Parameters:
+ *   in - array of input segments.
+ *   in_count - number of input segments.
+ *   out - array of output segments, with at least b64enclen(total) - 1
+ *     characters between them for total bytes of input.
+ *   out_count - number of output segments.
+ * Returns:
+ *   size_t number of characters written, or 0 if the output segments are
+ *   too small, in which case nothing is written.
+ */
+size_t b64enc_iov(const b64_iov *in, size_t in_count, const b64_iov *out, size_t out_count);
+
+/*
+ * b64dec_iov
+ *   Decode the base64 in a list of input segments, taken in order as one
+ *   message, across a list of output segments. Groups are free to
+ *   straddle segments on either side.
+ * Parameters:
+ *   in - array of input segments.
+ *   in_count - number of input segments.
+ *   out - array of output segments.
+ *   out_count - number of output segments.
+ *   flags - decoder flags OR-ed together, or 0.
+ * Returns:
+ *   size_t number of bytes written, or 0 if the input is not valid or
+ *   the output segments ran out of room. Output contents are undefined
+ *   in that case.
+ */
+size_t b64dec_iov(const b64_iov *in, size_t in_count, const b64_iov *out, size_t out_count, int flags);
+
+/*
+ * b64_crc32
+ *   CRC-32 as used by zlib, PNG and Ethernet. Can be run over data in
+ *   pieces, passing the result for one piece in with the next.
+ * Parameters:
+ *   crc - 0 to start, or the result so far.
+ *   data - pointer to the bytes to add.
+ *   len - number of bytes.
+ * Returns:
+ *   uint32_t CRC of all the data so far.
+ */
+uint32_t b64_crc32(uint32_t crc, const void *data, size_t len);
+
+/*
+ * b64_crc32_hook
+ *   A b64_sink for b64enc_set_hook() and b64dec_set_hook() that keeps a
+ *   running b64_crc32().
+ * Parameters:
+ *   arg - pointer to a uint32_t, set to 0 before the message starts.
+ */
+void b64_crc32_hook(void *arg, const uint8_t *data, size_t len);
+
+/*
+ * b64enc_parallel
+ *   Same as b64enc(), but large inputs are split on group boundaries and
+ *   encoded on several cores at once, each writing its own part of the
+ *   output. Small inputs are encoded on the calling thread. Uses FreeRTOS
+ *   tasks on ESP32 and pthreads on POSIX hosts.
+ * Parameters:
+ *   unenc - pointer to a character array with the contents to be encoded.
+ *   enc - pointer to a byte array that will be filled with base64 output.
+ *   unenc_len - length of the data pointed to by unenc.
+ *   threads - most threads to use, counting the calling one. Zero or less
+ *     means one per core.
+ * Returns:
+ *   size_t number of characters encoded, not counting the NULL
+ *   terminator.
+ */
+size_t b64enc_parallel(char *unenc, char *enc, size_t unenc_len, int threads);
+
+/*
+ * b64dec_parallel
+ *   Same as b64dec(), but large inputs are decoded on several cores at
+ *   once, as with b64enc_parallel().
+ * Parameters:
+ *   enc - pointer to the base64 encoded string.
+ *   dec - pointer to a byte array that will be filled with decoded output.
+ *   enc_len - the length of the encoded string (i.e. 'sizeof enc'.)
+ *   threads - most threads to use, counting the calling one. Zero or less
+ *     means one per core.
+ * Returns:
+ *   size_t number of bytes decoded, or 0 if the input is not a valid
+ *   base64 string.
+ */
+size_t b64dec_parallel(char *enc, char *dec, size_t enc_len, int threads);
+
+/*
+ * b64dec_pipe
+ *   A decoder running on its own task, fed through a ring buffer, so
+ *   receiving base64 and decoding it overlap. Opaque.
+ */
+typedef struct b64dec_pipe b64dec_pipe;
+
+/*
+ * b64dec_pipe_start
+ *   Start a decoder task for one message. On ESP32 it's a FreeRTOS task at
+ *   the caller's priority, and on POSIX hosts a thread. Elsewhere decoding
+ *   happens inside b64dec_pipe_feed() instead.
+ * Parameters:
+ *   ring_len - size of the ring buffer in bytes, or 0 for a default.
+ *     Larger rides out longer stalls in the sink.
+ *   flags - decoder flags, as for b64dec_init_flags().
+ *   sink - called with each run of decoded bytes.
+ *   arg - passed through to sink.
+ *   core - core to pin the task to on ESP32, or -1 for any. The other
+ *     core from the one receiving the data is usually best.
+ * Returns:
+ *   Pointer to the pipe, or NULL if memory or a task couldn't be had.
+ */
+b64dec_pipe *b64dec_pipe_start(size_t ring_len, int flags, b64_sink sink, void *arg, int core);
+
+/*
+ * b64dec_pipe_feed
+ *   Pass the next chunk of base64 to the decoder task. Returns as soon as
+ *   the chunk is copied into the ring, waiting only while the ring is
+ *   full. Only one task may feed a pipe. The message ends only with
+ *   b64dec_pipe_finish(); a NULL character in a chunk is invalid input.
+ * Parameters:
+ *   pipe - pointer from b64dec_pipe_start().
+ *   enc - pointer to the chunk.
+ *   enc_len - length of the chunk.
+ * Returns:
+ *   Integer 0, or -1 if the decoder has already found invalid input, in
+ *   which case there's no point sending any more.
+ */
+int b64dec_pipe_feed(b64dec_pipe *pipe, const char *enc, size_t enc_len);
+
+/*
+ * b64dec_pipe_finish
+ *   End the message, wait for the decoder task to hand over the last of
+ *   the bytes, and free the pipe.
+ * Parameters:
+ *   pipe - pointer from b64dec_pipe_start(). Not valid afterwards.
+ * Returns:
+ *   Integer 0 if the whole message was valid, or -1 if it was invalid or
+ *   cut short.
+ */
+int b64dec_pipe_finish(b64dec_pipe *pipe);
+
+/*
+ * b64_stats
+ *   Running totals kept when the library is built with B64_STATS defined,
+ *   for finding out where time goes on devices in the field. Streaming
+ *   updates count as calls. Parallel calls only count the part done on
+ *   the calling thread. Without B64_STATS nothing is counted and the
+ *   codec carries no overhead at all.
+ *   enc_calls, dec_calls - number of encode and decode calls.
+ *   enc_bytes, dec_chars - bytes encoded and characters decoded.
+ *   enc_cycles, dec_cycles - CPU cycles spent, where the target has a
+ *     cycle counter (rdtsc on x86, ccount on ESP32 and ESP8266.)
+ *   rejected - decodes rejected, indexed by b64_status (B64_ERR_CHAR,
+ *     B64_ERR_PAD or B64_ERR_TRUNC.)
+ */
+typedef struct b64_stats {
+  size_t enc_calls;
+  size_t enc_bytes;
+  uint64_t enc_cycles;
+  size_t dec_calls;
+  size_t dec_chars;
+  uint64_t dec_cycles;
+  size_t rejected[4];
+} b64_stats;
+
+/*
+ * b64_get_stats
+ *   Copy out the totals so far.
+ * Parameters:
+ *   stats - pointer to a b64_stats to fill in.
+ * Returns:
+ *   Integer 0, or -1 if the library was built without B64_STATS, in
+ *   which case stats is zeroed.
+ */
+int b64_get_stats(b64_stats *stats);
+
+/*
+ * b64_reset_stats
+ *   Set all the totals back to zero.
+ */
+void b64_reset_stats(void);
+
+/*
+ * b64_event
+ *   One encode or decode call, as passed to a trace hook.
+ *   op - B64_OP_ENCODE or B64_OP_DECODE.
+ *   in_len, out_len - bytes or characters read and written.
+ *   status - B64_OK, or why this call rejected its input.
+ *   cycles - CPU cycles the call took, or 0 without a cycle counter.
+ */
+typedef enum b64_op {
+  B64_OP_ENCODE,
+  B64_OP_DECODE
+} b64_op;
+
+typedef struct b64_event {
+  b64_op op;
+  size_t in_len;
+  size_t out_len;
+  b64_status status;
+  uint64_t cycles;
+} b64_event;
+
+typedef void (*b64_trace)(void *arg, const b64_event *event);
+
+/*
+ * b64_set_trace
+ *   Have every encode and decode call reported to a hook as it finishes,
+ *   on the calling task. Keep the hook short, since it runs on the hot
+ *   path, and in IRAM if the codec is built with B64_USE_IRAM.
+ * Parameters:
+ *   trace - function to call, or NULL to stop.
+ *   arg - passed through to trace.
+ * Returns:
+ *   Integer 0, or -1 if the library was built without B64_STATS.
+ */
+int b64_set_trace(b64_trace trace, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
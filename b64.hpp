@@ -0,0 +1,694 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+  
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * C++ interface. Header only, and needs C++17 and a standard library, so
+ * it suits ESP32 and host builds but not AVR. Compile-time decoding of
+ * string literals needs C++20. The C functions in b64.h are unaffected
+ * and remain the fastest way to handle standard base64 at runtime; the
+ * encode_into() and decode_into() helpers near the end call them.
+ */
+
+#ifndef B64_HPP
+#define B64_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <b64.h>
+
+namespace b64 {
+
+/*
+ * Alphabets
+ *   An alphabet is any type with a 'static constexpr char chars[65]'
+ *   member holding its 64 characters in order (plus the terminator.) The
+ *   two from RFC4648 are provided. Others can be declared the same way and
+ *   are checked at compile time.
+ */
+struct standard_alphabet {
+  static constexpr char chars[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+};
+
+struct url_alphabet {
+  static constexpr char chars[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+};
+
+/*
+ * padding
+ *   Whether a codec writes '=' padding when encoding, and requires it when
+ *   decoding (padding::required), or neither writes nor accepts it
+ *   (padding::none), as with base64url in JWT.
+ */
+enum class padding { required, none };
+
+namespace detail {
+
+constexpr char pad = '=';
+constexpr std::uint8_t invalid = 0xFF;
+
+// An alphabet needs 64 distinct 7-bit characters, none of them padding.
+template <class Alphabet>
+constexpr bool valid_alphabet() {
+  if (sizeof Alphabet::chars != 65 || Alphabet::chars[64] != '\0') return false;
+  for (std::size_t i = 0; i < 64; i++) {
+    unsigned char c = static_cast<unsigned char>(Alphabet::chars[i]);
+    if (c == 0 || c >= 0x80 || c == pad) return false;
+    for (std::size_t k = 0; k < i; k++) {
+      if (Alphabet::chars[k] == Alphabet::chars[i]) return false;
+    }
+  }
+  return true;
+}
+
+// The reverse table for an alphabet, the same shape as b64revmap in b64.c.
+template <class Alphabet>
+constexpr std::array<std::uint8_t, 256> make_revmap() {
+  std::array<std::uint8_t, 256> revmap{};
+  for (auto &value : revmap) value = invalid;
+  for (std::size_t i = 0; i < 64; i++) {
+    revmap[static_cast<unsigned char>(Alphabet::chars[i])] = static_cast<std::uint8_t>(i);
+  }
+  return revmap;
+}
+
+}  // namespace detail
+
+/*
+ * Lengths
+ *   Buffer sizes worked out from lengths alone, never looking at the data,
+ *   so they can size a std::array at compile time or reserve memory for a
+ *   whole batch once. None of them count a NULL terminator, except the
+ *   batch ones, which match b64enclen_batch(). Anything too big for a
+ *   size_t gives npos instead of wrapping round to a small number.
+ */
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+namespace detail {
+
+// a * b + c, or npos if it doesn't fit below npos.
+constexpr std::size_t muladd(std::size_t a, std::size_t b, std::size_t c) noexcept {
+  if (a == npos || c == npos) return npos;
+  if (b != 0 && a > (npos - 1 - c) / b) return npos;
+  return a * b + c;
+}
+
+}  // namespace detail
+
+/*
+ * encoded_size
+ *   Exact number of characters n bytes encode to, with or without
+ *   padding. The same as b64enclen(n) - 1 when padded.
+ */
+constexpr std::size_t encoded_size(std::size_t n, padding p = padding::required) noexcept {
+  if (p == padding::required) return detail::muladd(n / 3 + (n % 3 != 0), 4, 0);
+  return detail::muladd(n / 3, 4, n % 3 ? n % 3 + 1 : 0);
+}
+
+/*
+ * wrapped_size
+ *   Exact number of characters, line breaks included, that b64enc_wrap()
+ *   writes for n bytes. The same as b64enclen_wrap() - 1. Returns npos if
+ *   line_len isn't a multiple of four.
+ */
+constexpr std::size_t wrapped_size(std::size_t n, std::size_t line_len, int flags = 0) noexcept {
+  std::size_t chars = encoded_size(n);
+  if (line_len == 0 || line_len % 4 != 0 || chars == npos) return npos;
+  std::size_t breaks = chars == 0 ? 0 : (chars - 1) / line_len + ((flags & B64_WRAP_FINAL) ? 1 : 0);
+  return detail::muladd(breaks, (flags & B64_WRAP_CRLF) ? 2 : 1, chars);
+}
+
+/*
+ * max_decoded_size
+ *   Most bytes n characters can decode to, padded, unpadded or with
+ *   whitespace. For a chunk of a stream, where a partial group can be
+ *   carried in, use b64dec_updatelen() instead.
+ */
+constexpr std::size_t max_decoded_size(std::size_t n) noexcept {
+  return n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0);
+}
+
+/*
+ * decoded_size
+ *   Exact number of bytes n characters of unpadded base64 decode to, from
+ *   the length alone. Returns npos for a length no unpadded message can
+ *   have. Padded base64 needs a look at its last two characters, which
+ *   basic_codec::decoded_length() does.
+ */
+constexpr std::size_t decoded_size(std::size_t n) noexcept {
+  return n % 4 == 1 ? npos : max_decoded_size(n);
+}
+
+/*
+ * encoded_size_batch
+ *   Arena for b64enc_batch() holding count messages of up to max_len
+ *   bytes each, NULL terminators included.
+ */
+constexpr std::size_t encoded_size_batch(std::size_t count, std::size_t max_len) noexcept {
+  return detail::muladd(detail::muladd(encoded_size(max_len), 1, 1), count, 0);
+}
+
+/*
+ * max_decoded_size_batch
+ *   Arena for b64dec_batch() holding count messages of up to max_len
+ *   characters each.
+ */
+constexpr std::size_t max_decoded_size_batch(std::size_t count, std::size_t max_len) noexcept {
+  return detail::muladd(max_decoded_size(max_len), count, 0);
+}
+
+/*
+ * basic_codec
+ *   Encoder and decoder for one alphabet and padding rule. Both tables are
+ *   built at compile time and every choice is made by the template, so
+ *   each codec is its own straight-line loop with no branching on the
+ *   alphabet at runtime. All members are static and constexpr.
+ */
+template <class Alphabet, padding Padding = padding::required>
+struct basic_codec {
+  static_assert(detail::valid_alphabet<Alphabet>(),
+                "a base64 alphabet needs 64 distinct 7-bit characters, not including '='");
+
+  // Returned by decode() for input that isn't valid for this codec.
+  static constexpr std::size_t npos = b64::npos;
+
+  static constexpr const char (&map)[65] = Alphabet::chars;
+  static constexpr std::array<std::uint8_t, 256> revmap = detail::make_revmap<Alphabet>();
+
+  /*
+   * encoded_length
+   *   Number of characters encode() writes for n bytes. Unlike b64enclen()
+   *   there is no room for a NULL terminator, because none is written.
+   */
+  static constexpr std::size_t encoded_length(std::size_t n) noexcept {
+    return encoded_size(n, Padding);
+  }
+
+  /*
+   * max_decoded_length
+   *   Most bytes decode() can write for n characters. Exact for input
+   *   without padding.
+   */
+  static constexpr std::size_t max_decoded_length(std::size_t n) noexcept {
+    return max_decoded_size(n);
+  }
+
+  /*
+   * decoded_length
+   *   Exact number of bytes decode() writes for these n characters, from
+   *   the length and padding alone. Characters aren't checked, so decode()
+   *   may still fail. Returns npos if the length can't be valid.
+   */
+  static constexpr std::size_t decoded_length(const char *in, std::size_t n) noexcept {
+    if constexpr (Padding == padding::required) {
+      if (n % 4 != 0) return npos;
+      std::size_t len = n / 4 * 3;
+      if (n >= 4 && in[n - 1] == detail::pad) len -= in[n - 2] == detail::pad ? 2 : 1;
+      return len;
+    }
+    else {
+      return decoded_size(n);
+    }
+  }
+
+  /*
+   * encode
+   *   Encode n bytes from in, writing encoded_length(n) characters to out.
+   *   Returns the number of characters written.
+   */
+  static constexpr std::size_t encode(const std::uint8_t *in, std::size_t n, char *out) noexcept {
+    std::size_t i = 0;
+    std::size_t j = 0;
+
+    for (; i + 3 <= n; i += 3) {
+      std::uint32_t v = std::uint32_t(in[i]) << 16 | std::uint32_t(in[i + 1]) << 8 | in[i + 2];
+      out[j++] = map[v >> 18];
+      out[j++] = map[v >> 12 & 0x3F];
+      out[j++] = map[v >> 6 & 0x3F];
+      out[j++] = map[v & 0x3F];
+    }
+
+    if (n - i == 2) {
+      std::uint32_t v = std::uint32_t(in[i]) << 16 | std::uint32_t(in[i + 1]) << 8;
+      out[j++] = map[v >> 18];
+      out[j++] = map[v >> 12 & 0x3F];
+      out[j++] = map[v >> 6 & 0x3F];
+      if constexpr (Padding == padding::required) out[j++] = detail::pad;
+    }
+    else if (n - i == 1) {
+      std::uint32_t v = std::uint32_t(in[i]) << 16;
+      out[j++] = map[v >> 18];
+      out[j++] = map[v >> 12 & 0x3F];
+      if constexpr (Padding == padding::required) {
+        out[j++] = detail::pad;
+        out[j++] = detail::pad;
+      }
+    }
+
+    return j;
+  }
+
+  static std::size_t encode(const char *in, std::size_t n, char *out) noexcept {
+    return encode(reinterpret_cast<const std::uint8_t *>(in), n, out);
+  }
+
+  /*
+   * decode
+   *   Decode n characters from in (no NULL terminator expected), writing
+   *   at most max_decoded_length(n) bytes to out. Every character is
+   *   checked against the alphabet.
+   *   Returns the number of bytes written, or npos if the input is not
+   *   valid for this codec.
+   */
+  static constexpr std::size_t decode(const char *in, std::size_t n, std::uint8_t *out) noexcept {
+    std::size_t full = n - n % 4;
+    std::size_t tail = n % 4;
+    std::size_t j = 0;
+
+    // Work out which characters are whole groups, and how many are left
+    // in a final short group, for this padding rule.
+    if constexpr (Padding == padding::required) {
+      if (tail != 0) return npos;
+      if (n >= 4 && in[n - 1] == detail::pad) {
+        tail = in[n - 2] == detail::pad ? 2 : 3;
+        full -= 4;
+      }
+    }
+    else {
+      if (tail == 1) return npos;
+    }
+
+    for (std::size_t i = 0; i < full; i += 4) {
+      std::uint8_t a = revmap[static_cast<unsigned char>(in[i])];
+      std::uint8_t b = revmap[static_cast<unsigned char>(in[i + 1])];
+      std::uint8_t c = revmap[static_cast<unsigned char>(in[i + 2])];
+      std::uint8_t d = revmap[static_cast<unsigned char>(in[i + 3])];
+      if ((a | b | c | d) & 0xC0) return npos;
+      out[j++] = static_cast<std::uint8_t>(a << 2 | b >> 4);
+      out[j++] = static_cast<std::uint8_t>(b << 4 | c >> 2);
+      out[j++] = static_cast<std::uint8_t>(c << 6 | d);
+    }
+
+    if (tail >= 2) {
+      std::uint8_t a = revmap[static_cast<unsigned char>(in[full])];
+      std::uint8_t b = revmap[static_cast<unsigned char>(in[full + 1])];
+      std::uint8_t c = tail == 3 ? revmap[static_cast<unsigned char>(in[full + 2])] : 0;
+      if ((a | b | c) & 0xC0) return npos;
+      out[j++] = static_cast<std::uint8_t>(a << 2 | b >> 4);
+      if (tail == 3) out[j++] = static_cast<std::uint8_t>(b << 4 | c >> 2);
+    }
+
+    return j;
+  }
+
+  static std::size_t decode(const char *in, std::size_t n, char *out) noexcept {
+    return decode(in, n, reinterpret_cast<std::uint8_t *>(out));
+  }
+};
+
+// Standard base64 with padding, the same encoding as b64enc() and b64dec().
+using codec = basic_codec<standard_alphabet, padding::required>;
+
+// base64url without padding, as used in JWT and WebAuthn.
+using url_codec = basic_codec<url_alphabet, padding::none>;
+
+// base64url with padding.
+using url_padded_codec = basic_codec<url_alphabet, padding::required>;
+
+/*
+ * encode
+ *   Encode a std::array of bytes, at compile time if the array is
+ *   constexpr. Returns a std::array of characters, NULL terminated so
+ *   .data() can be used as a C-style string.
+ * Example:
+ *   constexpr std::array<std::uint8_t, 3> key = {0x01, 0x02, 0x03};
+ *   constexpr auto key_b64 = b64::encode(key);
+ */
+template <class Codec = codec, std::size_t N>
+constexpr std::array<char, Codec::encoded_length(N) + 1> encode(const std::array<std::uint8_t, N> &data) noexcept {
+  std::array<char, Codec::encoded_length(N) + 1> out{};
+  Codec::encode(data.data(), N, out.data());
+  return out;
+}
+
+/*
+ * bump_arena
+ *   Hands out memory from a buffer the caller supplies, by moving a
+ *   pointer forward. Memory comes back all at once with reset(), at the
+ *   end of a request or a pass of loop(), or when the most recent
+ *   allocation is released. Never touches the heap, so a long-running
+ *   node can't fragment it. Not thread safe.
+ */
+class bump_arena {
+ public:
+  bump_arena(void *buf, std::size_t size) noexcept
+    : buf_(static_cast<unsigned char *>(buf)), size_(size), used_(0), last_(0) {}
+
+  bump_arena(const bump_arena &) = delete;
+  bump_arena &operator=(const bump_arena &) = delete;
+
+  /*
+   * allocate
+   *   Returns n bytes aligned to align (a power of two), or nullptr if
+   *   there isn't room left.
+   */
+  void *allocate(std::size_t n, std::size_t align = 1) noexcept {
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(buf_);
+    std::size_t start = static_cast<std::size_t>((base + used_ + align - 1) & ~std::uintptr_t(align - 1)) - base;
+    if (start > size_ || n > size_ - start) return nullptr;
+    last_ = used_;
+    used_ = start + n;
+    return buf_ + start;
+  }
+
+  // Give back p if it's the most recent allocation, otherwise do nothing.
+  void deallocate(void *p) noexcept {
+    if (p != nullptr && p >= buf_ + last_ && p < buf_ + used_) used_ = last_;
+  }
+
+  void reset() noexcept {
+    used_ = last_ = 0;
+  }
+
+  std::size_t used() const noexcept {
+    return used_;
+  }
+
+  std::size_t capacity() const noexcept {
+    return size_;
+  }
+
+ private:
+  unsigned char *buf_;
+  std::size_t size_;
+  std::size_t used_;
+  std::size_t last_;
+};
+
+/*
+ * static_arena
+ *   A bump_arena with its own N bytes of storage, for a global or a
+ *   member rather than a separate buffer.
+ */
+template <std::size_t N>
+class static_arena : public bump_arena {
+ public:
+  static_arena() noexcept : bump_arena(storage_, N) {}
+
+ private:
+  alignas(std::max_align_t) unsigned char storage_[N];
+};
+
+/*
+ * block_pool
+ *   Splits a buffer the caller supplies into equal blocks and hands them
+ *   out one at a time, in any order. Every allocation uses a whole block,
+ *   so the pool can't fragment however long it runs, and a block is back
+ *   in the pool as soon as it's released. Size blocks for the largest
+ *   message, e.g. b64enclen(max_payload). Not thread safe.
+ */
+class block_pool {
+ public:
+  block_pool(void *buf, std::size_t size, std::size_t block_size) noexcept : free_(nullptr), block_size_(0), available_(0) {
+    // Each free block holds a pointer to the next, so blocks are at least
+    // that big and aligned for it.
+    const std::size_t align = alignof(void *);
+    block_size_ = (block_size < sizeof(void *) ? sizeof(void *) : block_size + align - 1) & ~(align - 1);
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(buf);
+    std::size_t skip = static_cast<std::size_t>((base + align - 1) & ~std::uintptr_t(align - 1)) - base;
+    if (skip > size) return;
+    unsigned char *block = static_cast<unsigned char *>(buf) + skip;
+    for (std::size_t n = (size - skip) / block_size_; n > 0; n--) {
+      deallocate(block);
+      block += block_size_;
+    }
+  }
+
+  block_pool(const block_pool &) = delete;
+  block_pool &operator=(const block_pool &) = delete;
+
+  /*
+   * allocate
+   *   Returns a block if n fits in one and there is one free, otherwise
+   *   nullptr.
+   */
+  void *allocate(std::size_t n, std::size_t align = 1) noexcept {
+    if (n > block_size_ || align > alignof(void *) || free_ == nullptr) return nullptr;
+    void *block = free_;
+    free_ = *static_cast<void **>(block);
+    available_--;
+    return block;
+  }
+
+  void deallocate(void *p) noexcept {
+    if (p == nullptr) return;
+    *static_cast<void **>(p) = free_;
+    free_ = p;
+    available_++;
+  }
+
+  std::size_t block_size() const noexcept {
+    return block_size_;
+  }
+
+  std::size_t available() const noexcept {
+    return available_;
+  }
+
+ private:
+  void *free_;
+  std::size_t block_size_;
+  std::size_t available_;
+};
+
+/*
+ * owned_buffer
+ *   The result of encode_into() or decode_into(). Owns memory from an
+ *   arena or pool and gives it back when destroyed. Move-only, so there is
+ *   always exactly one owner. An empty owned_buffer (false in a boolean
+ *   context) means the allocator was full or the input was invalid. The
+ *   allocator must outlive every buffer it handed out.
+ */
+template <class T>
+class owned_buffer {
+ public:
+  owned_buffer() noexcept : data_(nullptr), size_(0), owner_(nullptr), release_(nullptr) {}
+
+  template <class Allocator>
+  owned_buffer(T *data, std::size_t size, Allocator &owner) noexcept
+    : data_(data), size_(size), owner_(&owner), release_(&release<Allocator>) {}
+
+  owned_buffer(owned_buffer &&other) noexcept
+    : data_(other.data_), size_(other.size_), owner_(other.owner_), release_(other.release_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  owned_buffer &operator=(owned_buffer &&other) noexcept {
+    if (this != &other) {
+      reset();
+      data_ = other.data_;
+      size_ = other.size_;
+      owner_ = other.owner_;
+      release_ = other.release_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  owned_buffer(const owned_buffer &) = delete;
+  owned_buffer &operator=(const owned_buffer &) = delete;
+
+  ~owned_buffer() {
+    reset();
+  }
+
+  // Give the memory back now rather than at destruction.
+  void reset() noexcept {
+    if (data_ != nullptr) release_(owner_, data_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  T *data() const noexcept {
+    return data_;
+  }
+
+  // Number of characters or bytes, not counting a NULL terminator.
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  T *begin() const noexcept {
+    return data_;
+  }
+
+  T *end() const noexcept {
+    return data_ + size_;
+  }
+
+  explicit operator bool() const noexcept {
+    return data_ != nullptr;
+  }
+
+ private:
+  template <class Allocator>
+  static void release(void *owner, void *p) noexcept {
+    static_cast<Allocator *>(owner)->deallocate(p);
+  }
+
+  T *data_;
+  std::size_t size_;
+  void *owner_;
+  void (*release_)(void *, void *);
+};
+
+/*
+ * encode_into
+ *   Encode with b64enc_bytes() into memory from alloc, a bump_arena,
+ *   block_pool, or anything else with the same allocate(n) and
+ *   deallocate(p) members. The result is NULL terminated, so .data() can
+ *   be used as a C-style string. Nothing is allocated on the heap.
+ *   Returns an owned_buffer of the encoded characters, or an empty one if
+ *   alloc has no room.
+ * Example:
+ *   static b64::static_arena<1024> arena;
+ *   auto msg = b64::encode_into(arena, payload, sizeof payload);
+ */
+template <class Allocator>
+owned_buffer<char> encode_into(Allocator &alloc, const void *data, std::size_t n) noexcept {
+  std::size_t size = b64enclen(n);
+  if (size == 0) return {};
+  char *enc = static_cast<char *>(alloc.allocate(size));
+  if (enc == nullptr) return {};
+  std::size_t len = b64enc_bytes(static_cast<const std::uint8_t *>(data), enc, n);
+  return owned_buffer<char>(enc, len, alloc);
+}
+
+template <class Allocator>
+owned_buffer<char> encode_into(Allocator &alloc, b64_span in) noexcept {
+  return encode_into(alloc, in.ptr, in.len);
+}
+
+template <class Allocator>
+owned_buffer<char> encode_into(Allocator &alloc, std::string_view in) noexcept {
+  return encode_into(alloc, in.data(), in.size());
+}
+
+/*
+ * decode_into
+ *   Decode with b64dec_bytes() into memory from alloc, as encode_into().
+ *   A NULL terminator at the end of the input is allowed but not needed.
+ *   Returns an owned_buffer of the decoded bytes, or an empty one if the
+ *   input isn't valid base64 or alloc has no room. Memory for invalid
+ *   input is given straight back.
+ */
+template <class Allocator>
+owned_buffer<std::uint8_t> decode_into(Allocator &alloc, const char *enc, std::size_t n) noexcept {
+  std::size_t max = b64declen_span(enc, n);
+  if (max == 0) return {};
+  std::uint8_t *dec = static_cast<std::uint8_t *>(alloc.allocate(max));
+  if (dec == nullptr) return {};
+  owned_buffer<std::uint8_t> out(dec, b64dec_bytes(enc, dec, n), alloc);
+  if (out.size() == 0) out.reset();
+  return out;
+}
+
+template <class Allocator>
+owned_buffer<std::uint8_t> decode_into(Allocator &alloc, b64_span in) noexcept {
+  return decode_into(alloc, static_cast<const char *>(in.ptr), in.len);
+}
+
+template <class Allocator>
+owned_buffer<std::uint8_t> decode_into(Allocator &alloc, std::string_view in) noexcept {
+  return decode_into(alloc, in.data(), in.size());
+}
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+namespace detail {
+
+// A string literal usable as a template argument (C++20.)
+template <std::size_t N>
+struct literal {
+  char chars[N];
+
+  constexpr literal(const char (&str)[N]) : chars{} {
+    for (std::size_t i = 0; i < N; i++) chars[i] = str[i];
+  }
+
+  constexpr std::size_t size() const {
+    return N - 1;
+  }
+};
+
+template <std::size_t N>
+struct decoded {
+  std::array<std::uint8_t, N> data;
+  bool ok;
+};
+
+template <class Codec, std::size_t N, std::size_t L>
+constexpr decoded<N> decode_literal(const literal<L> &enc) {
+  decoded<N> result{};
+  result.ok = Codec::decode(enc.chars, enc.size(), result.data.data()) == N;
+  return result;
+}
+
+}  // namespace detail
+
+/*
+ * decode
+ *   Decode a base64 string literal entirely at compile time, into a
+ *   std::array sized to fit exactly. Invalid base64 fails to compile.
+ *   Declared static constexpr, the bytes go straight into flash with
+ *   nothing to decode at boot. Needs C++20.
+ * Example:
+ *   static constexpr auto icon = b64::decode<"iVBORw0KGgo...">();
+ */
+template <detail::literal Enc, class Codec = codec>
+consteval auto decode() {
+  constexpr std::size_t n = Codec::decoded_length(Enc.chars, Enc.size());
+  static_assert(n != Codec::npos, "base64 literal has an invalid length");
+  constexpr auto result = detail::decode_literal<Codec, n>(Enc);
+  static_assert(result.ok, "base64 literal is not valid");
+  return result.data;
+}
+
+/*
+ * encode
+ *   Encode a string literal, not counting its terminator, at compile
+ *   time. Returns a NULL terminated std::array of characters. Needs C++20.
+ * Example:
+ *   static constexpr auto auth = b64::encode<"user:password">();
+ */
+template <detail::literal Str, class Codec = codec>
+consteval auto encode() {
+  std::array<char, Codec::encoded_length(Str.size()) + 1> out{};
+  std::array<std::uint8_t, Str.size()> bytes{};
+  for (std::size_t i = 0; i < Str.size(); i++) bytes[i] = static_cast<std::uint8_t>(Str.chars[i]);
+  Codec::encode(bytes.data(), Str.size(), out.data());
+  return out;
+}
+
+#endif
+
+}  // namespace b64
+
+#endif
@@ -0,0 +1,214 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+  
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Multi-core encode and decode. Groups of three bytes (four characters)
+ * don't depend on each other, so the input is cut on group boundaries and
+ * each core writes its own slice of the output. Worker threads come from
+ * FreeRTOS on ESP32 and pthreads on POSIX hosts. Anywhere else, and for
+ * inputs too small to be worth it, everything runs on the calling thread.
+ */
+
+#include <b64.h>
+#include "b64_priv.h"
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#define B64_THREADS_FREERTOS 1
+#elif defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define B64_THREADS_PTHREAD 1
+#endif
+
+// B64_PARALLEL_MIN - smallest slice of input, in bytes, worth handing to
+// another core. Starting a thread costs tens of microseconds on a host and
+// a FreeRTOS task far less relative to a much slower core.
+#ifndef B64_PARALLEL_MIN
+#if defined(ESP_PLATFORM)
+#define B64_PARALLEL_MIN 8192
+#else
+#define B64_PARALLEL_MIN 262144
+#endif
+#endif
+
+// B64_PARALLEL_MAX - the most workers a single call will use.
+#define B64_PARALLEL_MAX 16
+
+// A slice of work for one worker. The calling thread always takes the
+// last slice, which also holds the padding and the terminator.
+struct b64_job {
+  int decode;
+  const char *in;
+  char *out;
+  size_t len;
+  int ok;
+#if defined(B64_THREADS_FREERTOS)
+  SemaphoreHandle_t done;
+#elif defined(B64_THREADS_PTHREAD)
+  pthread_t thread;
+#endif
+};
+
+static void run_job(struct b64_job *job) {
+  if (job->decode) {
+    job->ok = b64dec_blocks(job->in, (unsigned char *) job->out, job->len) == job->len;
+  }
+  else {
+    b64enc_blocks((const unsigned char *) job->in, job->out, job->len);
+    job->ok = 1;
+  }
+}
+
+#if defined(B64_THREADS_FREERTOS)
+
+static void job_task(void *arg) {
+  struct b64_job *job = (struct b64_job *) arg;
+  run_job(job);
+  xSemaphoreGive(job->done);
+  vTaskDelete(NULL);
+}
+
+static int cores(void) {
+  return portNUM_PROCESSORS;
+}
+
+// Spread workers over the other cores first, so the calling task keeps
+// its own core to itself.
+static int job_start(struct b64_job *job, int index) {
+  int core = (xPortGetCoreID() + 1 + index) % portNUM_PROCESSORS;
+  job->done = xSemaphoreCreateBinary();
+  if (!job->done) return -1;
+  if (xTaskCreatePinnedToCore(job_task, "b64", 2048, job, uxTaskPriorityGet(NULL), NULL, core) != pdPASS) {
+    vSemaphoreDelete(job->done);
+    return -1;
+  }
+  return 0;
+}
+
+static void job_wait(struct b64_job *job) {
+  xSemaphoreTake(job->done, portMAX_DELAY);
+  vSemaphoreDelete(job->done);
+}
+
+#elif defined(B64_THREADS_PTHREAD)
+
+static void *job_thread(void *arg) {
+  run_job((struct b64_job *) arg);
+  return NULL;
+}
+
+static int cores(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+}
+
+static int job_start(struct b64_job *job, int index) {
+  (void) index;
+  return pthread_create(&job->thread, NULL, job_thread, job) == 0 ? 0 : -1;
+}
+
+static void job_wait(struct b64_job *job) {
+  pthread_join(job->thread, NULL);
+}
+
+#else
+
+static int cores(void) {
+  return 1;
+}
+
+static int job_start(struct b64_job *job, int index) {
+  (void) index;
+  run_job(job);
+  return 0;
+}
+
+static void job_wait(struct b64_job *job) {
+  (void) job;
+}
+
+#endif
+
+// run_jobs - cut 'units' whole groups of 'unit_in' input and 'unit_out'
+// output bytes into up to 'threads' slices, start a worker on all but the
+// last, and wait for them. Returns the number of groups handed out, for
+// the caller to finish the rest, or 0 if no workers were worth starting.
+// *ok is cleared if any worker found invalid input.
+static size_t run_jobs(int decode, const char *in, char *out, size_t units,
+                       size_t unit_in, size_t unit_out, int threads, int *ok) {
+  struct b64_job jobs[B64_PARALLEL_MAX];
+  size_t per_job;
+  int started = 0;
+  size_t done = 0;
+
+  if (threads <= 0) threads = cores();
+  if (threads > B64_PARALLEL_MAX) threads = B64_PARALLEL_MAX;
+  if ((size_t) threads > units * unit_in / B64_PARALLEL_MIN) threads = (int) (units * unit_in / B64_PARALLEL_MIN);
+  if (threads < 2) return 0;
+
+  per_job = units / threads;
+  for (int k=0; k<threads-1; k++) {
+    struct b64_job *job = &jobs[started];
+    job->decode = decode;
+    job->in = in + done * unit_in;
+    job->out = out + done * unit_out;
+    job->len = per_job * unit_in;
+
+    // If a worker can't be had, just stop splitting. Whatever is left
+    // falls to the calling thread.
+    if (job_start(job, k) != 0) break;
+    started++;
+    done += per_job;
+  }
+
+  for (int k=0; k<started; k++) {
+    job_wait(&jobs[k]);
+    if (!jobs[k].ok) *ok = 0;
+  }
+
+  return done;
+}
+
+size_t b64enc_parallel(char *unenc, char *enc, size_t unenc_len, int threads) {
+  int ok = 1;
+  size_t groups = run_jobs(0, unenc, enc, unenc_len / 3, 3, 4, threads, &ok);
+
+  // What's left over is an ordinary, shorter message. Encoding it on this
+  // thread takes care of the last slice, the padding and the terminator.
+  return groups * 4 + b64enc_bytes((const uint8_t *) unenc + groups * 3, enc + groups * 4, unenc_len - groups * 3);
+}
+
+size_t b64dec_parallel(char *enc, char *dec, size_t enc_len, int threads) {
+  int ok = 1;
+  size_t groups;
+  size_t tail;
+
+  // Check the length the same way b64dec() does before trusting it to cut
+  // the work up. The last group is never handed out, since it may be
+  // padded.
+  if (enc_len < 5 || (enc_len - 1) %4 != 0) return 0;
+  groups = run_jobs(1, enc, dec, (enc_len - 1) / 4 - 1, 4, 3, threads, &ok);
+
+  // The rest of the string, short of its terminator, is itself valid
+  // base64 if the whole thing is, so b64dec_bytes() can finish it off.
+  tail = b64dec_bytes(enc + groups * 4, (uint8_t *) dec + groups * 3, enc_len - groups * 4 - 1);
+  if (!ok || tail == 0) return 0;
+
+  return groups * 3 + tail;
+}
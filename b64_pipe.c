@@ -0,0 +1,329 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Pipelined decoding. The task receiving base64 copies it into a ring
+ * buffer and goes straight back to the network, while a decoder task,
+ * pinned to the other core on ESP32, drains the ring through the streaming
+ * decoder and hands the bytes on. The ring is a FreeRTOS stream buffer on
+ * ESP32 and a mutex and condition variables on POSIX hosts. Anywhere else
+ * there is nothing to run a second task, so feeding decodes in place.
+ */
+
+#include <b64.h>
+#include <stdlib.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#define B64_THREADS_FREERTOS 1
+#elif defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define B64_THREADS_PTHREAD 1
+#endif
+
+// B64_PIPE_CHUNK - most characters the decoder task takes from the ring at
+// a time, and so the most bytes handed to the sink in one call (three
+// quarters of it.) Both buffers live in the pipe, not on the task's stack.
+// Without threads, feeding decodes this much at a time; kept small, since
+// that's AVR and other boards with a few KB of RAM.
+#ifndef B64_PIPE_CHUNK
+#if defined(B64_THREADS_FREERTOS)
+#define B64_PIPE_CHUNK 1024
+#elif defined(B64_THREADS_PTHREAD)
+#define B64_PIPE_CHUNK 65536
+#else
+#define B64_PIPE_CHUNK 64
+#endif
+#endif
+
+// B64_PIPE_STACK - stack for the decoder task on ESP32, in bytes. The sink
+// runs on it, and flash writes (as for OTA) need a fair amount.
+#ifndef B64_PIPE_STACK
+#define B64_PIPE_STACK 4096
+#endif
+
+// B64_PIPE_POLL - ticks the decoder task waits on an empty stream buffer
+// before looking again for the end of the message on ESP32.
+#ifndef B64_PIPE_POLL
+#define B64_PIPE_POLL pdMS_TO_TICKS(10)
+#endif
+
+struct b64dec_pipe {
+  b64dec_ctx ctx;
+  b64_sink sink;
+  void *arg;
+  volatile int error;
+  volatile int ended;
+  char enc[B64_PIPE_CHUNK];
+  char dec[B64_PIPE_CHUNK / 4 * 3 + 3];
+#if defined(B64_THREADS_FREERTOS)
+  StreamBufferHandle_t ring;
+  SemaphoreHandle_t done;
+#elif defined(B64_THREADS_PTHREAD)
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t readable;
+  pthread_cond_t writable;
+  char *ring;
+  size_t ring_len;
+  size_t head;
+  size_t count;
+#endif
+};
+
+// The decoder task raises the error flag and the feeder reads it, and on
+// ESP32 the feeder raises the end flag for the task, all outside any lock.
+// Release and acquire so each side sees the other's writes in order.
+#if defined(__GNUC__)
+#define B64_PIPE_RAISE(flag) __atomic_store_n(&(flag), 1, __ATOMIC_RELEASE)
+#define B64_PIPE_RAISED(flag) __atomic_load_n(&(flag), __ATOMIC_ACQUIRE)
+#else
+#define B64_PIPE_RAISE(flag) ((flag) = 1)
+#define B64_PIPE_RAISED(flag) (flag)
+#endif
+#define B64_PIPE_FAIL(pipe) B64_PIPE_RAISE((pipe)->error)
+#define B64_PIPE_FAILED(pipe) B64_PIPE_RAISED((pipe)->error)
+
+// pipe_decode - run one chunk through the decoder and on to the sink. The
+// message only ends at b64dec_pipe_finish(), so a NULL character in the
+// data is just invalid input, not an early end.
+static void pipe_decode(b64dec_pipe *pipe, const char *enc, size_t enc_len) {
+  int dec_len;
+
+  if (B64_PIPE_FAILED(pipe)) return;
+  if (memchr(enc, '\0', enc_len)) {
+    B64_PIPE_FAIL(pipe);
+    return;
+  }
+  dec_len = b64dec_update(&pipe->ctx, enc, pipe->dec, enc_len);
+  if (dec_len < 0) B64_PIPE_FAIL(pipe);
+  else if (dec_len > 0) pipe->sink(pipe->arg, (const uint8_t *) pipe->dec, dec_len);
+}
+
+#if defined(B64_THREADS_FREERTOS) || defined(B64_THREADS_PTHREAD)
+
+static size_t ring_send(b64dec_pipe *pipe, const char *enc, size_t enc_len);
+static size_t ring_receive(b64dec_pipe *pipe, char *enc, size_t enc_len);
+
+// pipe_task - the decoder side. Keeps draining the ring after an error,
+// until b64dec_pipe_finish() ends the message and the ring is empty, so a
+// feeder never blocks on a full ring that nobody is reading.
+static void pipe_task(b64dec_pipe *pipe) {
+  size_t n;
+
+  while ((n = ring_receive(pipe, pipe->enc, sizeof pipe->enc)) > 0) pipe_decode(pipe, pipe->enc, n);
+}
+
+#endif
+
+#if defined(B64_THREADS_FREERTOS)
+
+static void pipe_entry(void *arg) {
+  b64dec_pipe *pipe = (b64dec_pipe *) arg;
+  pipe_task(pipe);
+  xSemaphoreGive(pipe->done);
+  vTaskDelete(NULL);
+}
+
+static int pipe_start(b64dec_pipe *pipe, size_t ring_len, int core) {
+  BaseType_t affinity = core < 0 ? tskNO_AFFINITY : (BaseType_t) core;
+
+  pipe->ring = xStreamBufferCreate(ring_len, 1);
+  pipe->done = xSemaphoreCreateBinary();
+  if (pipe->ring && pipe->done &&
+      xTaskCreatePinnedToCore(pipe_entry, "b64dec", B64_PIPE_STACK, pipe, uxTaskPriorityGet(NULL), NULL, affinity) == pdPASS) {
+    return 0;
+  }
+  if (pipe->ring) vStreamBufferDelete(pipe->ring);
+  if (pipe->done) vSemaphoreDelete(pipe->done);
+  return -1;
+}
+
+static void pipe_wait(b64dec_pipe *pipe) {
+  xSemaphoreTake(pipe->done, portMAX_DELAY);
+  vSemaphoreDelete(pipe->done);
+  vStreamBufferDelete(pipe->ring);
+}
+
+static size_t ring_send(b64dec_pipe *pipe, const char *enc, size_t enc_len) {
+  return xStreamBufferSend(pipe->ring, enc, enc_len, portMAX_DELAY);
+}
+
+// ring_receive - wait for data, or for the end of the message once the
+// ring is empty, in which case it returns 0. A stream buffer can only wake
+// its reader with data, so the end flag is checked between timed waits.
+// It's read before each wait: everything sent before it was raised is
+// already in the ring by then.
+static size_t ring_receive(b64dec_pipe *pipe, char *enc, size_t enc_len) {
+  for (;;) {
+    int ended = B64_PIPE_RAISED(pipe->ended);
+    size_t n = xStreamBufferReceive(pipe->ring, enc, enc_len, B64_PIPE_POLL);
+    if (n > 0 || ended) return n;
+  }
+}
+
+static void ring_end(b64dec_pipe *pipe) {
+  B64_PIPE_RAISE(pipe->ended);
+}
+
+#elif defined(B64_THREADS_PTHREAD)
+
+static void *pipe_entry(void *arg) {
+  pipe_task((b64dec_pipe *) arg);
+  return NULL;
+}
+
+static int pipe_start(b64dec_pipe *pipe, size_t ring_len, int core) {
+  (void) core;
+  pipe->ring = malloc(ring_len);
+  if (!pipe->ring) return -1;
+  pipe->ring_len = ring_len;
+  pipe->head = 0;
+  pipe->count = 0;
+  pthread_mutex_init(&pipe->lock, NULL);
+  pthread_cond_init(&pipe->readable, NULL);
+  pthread_cond_init(&pipe->writable, NULL);
+  if (pthread_create(&pipe->thread, NULL, pipe_entry, pipe) == 0) return 0;
+  pthread_mutex_destroy(&pipe->lock);
+  pthread_cond_destroy(&pipe->readable);
+  pthread_cond_destroy(&pipe->writable);
+  free(pipe->ring);
+  return -1;
+}
+
+static void pipe_wait(b64dec_pipe *pipe) {
+  pthread_join(pipe->thread, NULL);
+  pthread_mutex_destroy(&pipe->lock);
+  pthread_cond_destroy(&pipe->readable);
+  pthread_cond_destroy(&pipe->writable);
+  free(pipe->ring);
+}
+
+// ring_send and ring_receive - copy as much as fits, or is there, in at
+// most two pieces around the wrap. Each waits only while it can do
+// nothing at all, the same as a FreeRTOS stream buffer. Once the message
+// has ended, ring_receive returns 0 for an empty ring instead of waiting.
+static size_t ring_send(b64dec_pipe *pipe, const char *enc, size_t enc_len) {
+  size_t n;
+  size_t tail;
+
+  pthread_mutex_lock(&pipe->lock);
+  while (pipe->count == pipe->ring_len) pthread_cond_wait(&pipe->writable, &pipe->lock);
+  if (enc_len > pipe->ring_len - pipe->count) enc_len = pipe->ring_len - pipe->count;
+  tail = (pipe->head + pipe->count) % pipe->ring_len;
+  n = pipe->ring_len - tail < enc_len ? pipe->ring_len - tail : enc_len;
+  memcpy(pipe->ring + tail, enc, n);
+  memcpy(pipe->ring, enc + n, enc_len - n);
+  pipe->count += enc_len;
+  pthread_cond_signal(&pipe->readable);
+  pthread_mutex_unlock(&pipe->lock);
+
+  return enc_len;
+}
+
+static size_t ring_receive(b64dec_pipe *pipe, char *enc, size_t enc_len) {
+  size_t n;
+
+  pthread_mutex_lock(&pipe->lock);
+  while (pipe->count == 0 && !pipe->ended) pthread_cond_wait(&pipe->readable, &pipe->lock);
+  if (enc_len > pipe->count) enc_len = pipe->count;
+  n = pipe->ring_len - pipe->head < enc_len ? pipe->ring_len - pipe->head : enc_len;
+  memcpy(enc, pipe->ring + pipe->head, n);
+  memcpy(enc + n, pipe->ring, enc_len - n);
+  pipe->head = (pipe->head + enc_len) % pipe->ring_len;
+  pipe->count -= enc_len;
+  pthread_cond_signal(&pipe->writable);
+  pthread_mutex_unlock(&pipe->lock);
+
+  return enc_len;
+}
+
+static void ring_end(b64dec_pipe *pipe) {
+  pthread_mutex_lock(&pipe->lock);
+  pipe->ended = 1;
+  pthread_cond_signal(&pipe->readable);
+  pthread_mutex_unlock(&pipe->lock);
+}
+
+#endif
+
+b64dec_pipe *b64dec_pipe_start(size_t ring_len, int flags, b64_sink sink, void *arg, int core) {
+  b64dec_pipe *pipe = malloc(sizeof *pipe);
+
+  if (!pipe) return NULL;
+  b64dec_init_flags(&pipe->ctx, flags);
+  pipe->sink = sink;
+  pipe->arg = arg;
+  pipe->error = 0;
+  pipe->ended = 0;
+
+#if defined(B64_THREADS_FREERTOS) || defined(B64_THREADS_PTHREAD)
+  if (ring_len == 0) ring_len = B64_PIPE_CHUNK * 2;
+  if (pipe_start(pipe, ring_len, core) != 0) {
+    free(pipe);
+    return NULL;
+  }
+#else
+  (void) ring_len;
+  (void) core;
+#endif
+
+  return pipe;
+}
+
+int b64dec_pipe_feed(b64dec_pipe *pipe, const char *enc, size_t enc_len) {
+  if (B64_PIPE_FAILED(pipe)) return -1;
+
+#if defined(B64_THREADS_FREERTOS) || defined(B64_THREADS_PTHREAD)
+  while (enc_len > 0) {
+    size_t n = ring_send(pipe, enc, enc_len);
+    enc += n;
+    enc_len -= n;
+  }
+#else
+  while (enc_len > 0) {
+    size_t n = enc_len < sizeof pipe->enc ? enc_len : sizeof pipe->enc;
+    pipe_decode(pipe, enc, n);
+    enc += n;
+    enc_len -= n;
+  }
+#endif
+
+  return B64_PIPE_FAILED(pipe) ? -1 : 0;
+}
+
+int b64dec_pipe_finish(b64dec_pipe *pipe) {
+  int result;
+  char last[3];  // Two at most, but sized for the flush it goes through.
+  int n;
+
+  // The decoder task drains what's left in the ring, then ends itself.
+#if defined(B64_THREADS_FREERTOS) || defined(B64_THREADS_PTHREAD)
+  ring_end(pipe);
+  pipe_wait(pipe);
+#endif
+
+  // An unpadded message can end part way through a group.
+  n = b64dec_final_bytes(&pipe->ctx, last);
+  if (n > 0) pipe->sink(pipe->arg, (const uint8_t *) last, n);
+  result = n < 0 || B64_PIPE_FAILED(pipe) ? -1 : 0;
+  free(pipe);
+
+  return result;
+}
@@ -0,0 +1,134 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+  
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Internal interfaces shared between the library's source files. Nothing
+ * here is part of the public API in b64.h and it may change at any time.
+ */
+
+#ifndef B64_PRIV_H
+#define B64_PRIV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tables defined in b64.c.
+extern const char b64map[];
+extern const char b64pad;
+extern const uint8_t b64revmap[256];
+
+/*
+ * b64enc_blocks
+ *   Encode whole groups of three bytes with the fastest available path.
+ *   unenc_len must be a multiple of three. No padding or terminator.
+ * Returns:
+ *   size_t number of characters written.
+ */
+size_t b64enc_blocks(const unsigned char *unenc, char *enc, size_t unenc_len);
+
+/*
+ * b64dec_blocks
+ *   Decode whole groups of four characters with the fastest available
+ *   path. The input must not hold padding.
+ * Returns:
+ *   size_t number of characters consumed, a multiple of four. Less than
+ *   enc_len means the group starting there holds an invalid character.
+ */
+size_t b64dec_blocks(const char *enc, unsigned char *dec, size_t enc_len);
+
+// B64_SIMD - set where b64_simd.c has vector kernels (x86 and AArch64.)
+// Elsewhere b64.c doesn't call into it at all, which keeps the one-shot
+// functions self-contained when they're placed in IRAM.
+#if !defined(B64_NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__) || (defined(__aarch64__) && defined(__ARM_NEON)))
+#define B64_SIMD 1
+#endif
+
+// B64_SIMD_ENC_MIN and B64_SIMD_DEC_MIN - shortest input any kernel does
+// anything with, in bytes and characters. Anything shorter goes straight
+// to the scalar loops.
+#define B64_SIMD_ENC_MIN 16
+#define B64_SIMD_DEC_MIN 24
+
+/*
+ * Kernels are the vectorized inner loops in b64_simd.c. The best one the
+ * CPU supports is picked the first time it's needed. The scalar loops in
+ * b64.c are always there as the fallback and to finish off what a kernel
+ * leaves behind.
+ */
+enum {
+  B64_KERNEL_SCALAR,
+  B64_KERNEL_SSSE3,
+  B64_KERNEL_AVX2,
+  B64_KERNEL_NEON,
+  B64_KERNEL_COUNT
+};
+
+/*
+ * b64enc_simd
+ *   Encode as much of the input as the selected kernel handles in whole
+ *   vectors. Never reads past unenc_len.
+ * Returns:
+ *   size_t number of input bytes consumed, always a multiple of three.
+ *   Four characters are written for every three bytes consumed.
+ */
+size_t b64enc_simd(const unsigned char *unenc, char *enc, size_t unenc_len);
+
+/*
+ * b64dec_simd
+ *   Decode as much of the input as the selected kernel handles in whole
+ *   vectors, validating every character on the way. enc_len must be a
+ *   multiple of four and the input must hold no padding. Never writes past
+ *   enc_len / 4 * 3 bytes of output.
+ * Returns:
+ *   size_t number of characters consumed, always a multiple of four. Three
+ *   bytes are written for every four characters consumed. Decoding stops
+ *   in front of the first vector holding a character outside the base64
+ *   alphabet, so the first bad character is at or after that offset.
+ */
+size_t b64dec_simd(const char *enc, unsigned char *dec, size_t enc_len);
+
+/*
+ * b64_kernel
+ *   Returns the kernel in use, selecting one first if that hasn't been
+ *   done yet.
+ */
+int b64_kernel(void);
+
+/*
+ * b64_set_kernel
+ *   Force a particular kernel, for benchmarking and for checking kernels
+ *   against each other.
+ * Returns:
+ *   0 on success, or -1 if this build or CPU can't run that kernel.
+ */
+int b64_set_kernel(int kernel);
+
+/*
+ * b64_kernel_name
+ *   Returns a short printable name for a kernel.
+ */
+const char *b64_kernel_name(int kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,411 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+  
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Vectorized kernels. On targets without SIMD (ESP32, AVR, Cortex-M) this
+ * file builds down to stubs that leave all the work to the scalar loops in
+ * b64.c. Define B64_NO_SIMD to get the same result anywhere.
+ */
+
+#include "b64_priv.h"
+
+#if !defined(B64_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define B64_X86 1
+#include <immintrin.h>
+#elif !defined(B64_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define B64_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef B64_X86
+
+// Three bytes of input become four 6-bit indices. The shuffle repeats the
+// middle byte of each group so every index ends up inside its own 16-bit
+// lane, where a pair of multiplies shifts it into position. Then a small
+// lookup turns indices into characters by adding an offset per range (A-Z,
+// a-z, 0-9, '+' and '/'), rather than a 64-byte table lookup.
+// See Muła and Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions" (2018).
+
+__attribute__((target("ssse3")))
+static inline __m128i enc_reshuffle_ssse3(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i enc_translate_ssse3(__m128i indices) {
+  const __m128i shift = _mm_setr_epi8(
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  return _mm_add_epi8(_mm_shuffle_epi8(shift, range), indices);
+}
+
+// 12 bytes in, 16 characters out. Each load reads 16 bytes, so stop while
+// there are still four bytes to spare.
+__attribute__((target("ssse3")))
+static size_t enc_ssse3(const unsigned char *unenc, char *enc, size_t unenc_len) {
+  size_t i = 0;
+  size_t j = 0;
+
+  for (; i+16<=unenc_len; i+=12, j+=16) {
+    __m128i in = _mm_loadu_si128((const __m128i *) (unenc + i));
+    _mm_storeu_si128((__m128i *) (enc + j), enc_translate_ssse3(enc_reshuffle_ssse3(in)));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i enc_reshuffle_avx2(__m256i in) {
+  in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+  const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+  const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+  const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(t1, t3);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i enc_translate_avx2(__m256i indices) {
+  const __m256i shift = _mm256_setr_epi8(
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+  range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+  return _mm256_add_epi8(_mm256_shuffle_epi8(shift, range), indices);
+}
+
+// 24 bytes in, 32 characters out. AVX2 shuffles can't cross the two
+// 128-bit lanes, so each lane is loaded separately with its 12 bytes at
+// the bottom. The upper load reads 16 bytes from offset 12.
+__attribute__((target("avx2")))
+static size_t enc_avx2(const unsigned char *unenc, char *enc, size_t unenc_len) {
+  size_t i = 0;
+  size_t j = 0;
+
+  for (; i+28<=unenc_len; i+=24, j+=32) {
+    __m256i in = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (unenc + i))),
+      _mm_loadu_si128((const __m128i *) (unenc + i + 12)), 1);
+    _mm256_storeu_si256((__m256i *) (enc + j), enc_translate_avx2(enc_reshuffle_avx2(in)));
+  }
+
+  // Let the narrower kernel pick up one more group if it fits. It's built
+  // with legacy SSE encodings, and GCC doesn't add vzeroupper for a
+  // target("avx2") function on its own, so clear the upper halves first.
+  // Left dirty, every later SSE instruction pays for the state change,
+  // which more than triples the time for a stream of short messages.
+  _mm256_zeroupper();
+  return i + enc_ssse3(unenc + i, enc + j, unenc_len - i);
+}
+
+// Decoding splits each character into nibbles and uses two 16-entry
+// lookups to classify it. A character is valid only if its low and high
+// nibble classes share no bits, which checks a whole vector in one test.
+// A third lookup, keyed on the high nibble, gives the offset that turns
+// the character into its 6-bit value. The values are then packed four to
+// three with multiply-adds and a shuffle. Same paper as above.
+
+__attribute__((target("ssse3")))
+static size_t dec_ssse3(const char *enc, unsigned char *dec, size_t enc_len) {
+  const __m128i lut_lo = _mm_setr_epi8(
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lut_hi = _mm_setr_epi8(
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+  size_t i = 0;
+  size_t j = 0;
+
+  // 16 characters in, 12 bytes out. Each store writes 16 bytes, so stop
+  // while the output still has four bytes of room after the real ones.
+  for (; i+24<=enc_len; i+=16, j+=12) {
+    __m128i str = _mm_loadu_si128((const __m128i *) (enc + i));
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+    const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+    const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF) break;
+
+    str = _mm_add_epi8(str, roll);
+    str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+    str = _mm_shuffle_epi8(str, _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i *) (dec + j), str);
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2")))
+static size_t dec_avx2(const char *enc, unsigned char *dec, size_t enc_len) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8(
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+  size_t i = 0;
+  size_t j = 0;
+
+  // 32 characters in, 24 bytes out. Each store writes 32 bytes, so stop
+  // while the output still has eight bytes of room after the real ones.
+  for (; i+44<=enc_len; i+=32, j+=24) {
+    __m256i str = _mm256_loadu_si256((const __m256i *) (enc + i));
+    const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+    const __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+    const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+    const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+
+    if (!_mm256_testz_si256(lo, hi)) break;
+
+    str = _mm256_add_epi8(str, roll);
+    str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+    str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+    str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+    _mm256_storeu_si256((__m256i *) (dec + j), str);
+  }
+
+  // Let the narrower kernel pick up where this one stopped. If it was
+  // stopped by a bad character, that kernel will stop there as well. The
+  // upper halves are cleared first, as in enc_avx2().
+  _mm256_zeroupper();
+  return i + dec_ssse3(enc + i, dec + j, enc_len - i);
+}
+
+#endif
+
+#ifdef B64_NEON
+
+// 48 bytes in, 64 characters out. The de-interleaving load splits every
+// group of three into its own vector, so the indices are plain shifts and
+// masks. The 64-byte alphabet fits in a four-register table lookup.
+static size_t enc_neon(const unsigned char *unenc, char *enc, size_t unenc_len) {
+  uint8x16x4_t map;
+  size_t i = 0;
+  size_t j = 0;
+
+  map.val[0] = vld1q_u8((const uint8_t *) b64map);
+  map.val[1] = vld1q_u8((const uint8_t *) b64map + 16);
+  map.val[2] = vld1q_u8((const uint8_t *) b64map + 32);
+  map.val[3] = vld1q_u8((const uint8_t *) b64map + 48);
+
+  for (; i+48<=unenc_len; i+=48, j+=64) {
+    const uint8x16x3_t in = vld3q_u8(unenc + i);
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    uint8x16x4_t out;
+
+    out.val[0] = vshrq_n_u8(in.val[0], 2);
+    out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+    out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+    out.val[3] = vandq_u8(in.val[2], mask);
+
+    out.val[0] = vqtbl4q_u8(map, out.val[0]);
+    out.val[1] = vqtbl4q_u8(map, out.val[1]);
+    out.val[2] = vqtbl4q_u8(map, out.val[2]);
+    out.val[3] = vqtbl4q_u8(map, out.val[3]);
+    vst4q_u8((uint8_t *) enc + j, out);
+  }
+
+  return i;
+}
+
+// 64 characters in, 48 bytes out. The de-interleaving load puts each
+// place of the group of four in its own vector. Characters are translated
+// through b64revmap, 128 entries at a time using a lookup for the lower
+// half and a lookup-extend for the upper half. Invalid characters come
+// back with the top bit set, and so does anything above 0x7F, so OR-ing
+// the lot together checks the whole block at once.
+static size_t dec_neon(const char *enc, unsigned char *dec, size_t enc_len) {
+  uint8x16x4_t lut_lo;
+  uint8x16x4_t lut_hi;
+  size_t i = 0;
+  size_t j = 0;
+
+  for (int k=0; k<4; k++) {
+    lut_lo.val[k] = vld1q_u8(b64revmap + 16 * k);
+    lut_hi.val[k] = vld1q_u8(b64revmap + 64 + 16 * k);
+  }
+
+  for (; i+64<=enc_len; i+=64, j+=48) {
+    const uint8x16x4_t str = vld4q_u8((const uint8_t *) enc + i);
+    const uint8x16_t flip = vdupq_n_u8(0x40);
+    uint8x16x4_t val;
+    uint8x16x3_t out;
+
+    for (int k=0; k<4; k++) {
+      val.val[k] = vqtbx4q_u8(vqtbl4q_u8(lut_lo, str.val[k]), lut_hi, veorq_u8(str.val[k], flip));
+    }
+
+    uint8x16_t check = vorrq_u8(vorrq_u8(val.val[0], val.val[1]), vorrq_u8(val.val[2], val.val[3]));
+    check = vorrq_u8(check, vorrq_u8(vorrq_u8(str.val[0], str.val[1]), vorrq_u8(str.val[2], str.val[3])));
+    if (vmaxvq_u8(check) & 0x80) break;
+
+    out.val[0] = vorrq_u8(vshlq_n_u8(val.val[0], 2), vshrq_n_u8(val.val[1], 4));
+    out.val[1] = vorrq_u8(vshlq_n_u8(val.val[1], 4), vshrq_n_u8(val.val[2], 2));
+    out.val[2] = vorrq_u8(vshlq_n_u8(val.val[2], 6), val.val[3]);
+    vst3q_u8(dec + j, out);
+  }
+
+  return i;
+}
+
+#endif
+
+static size_t enc_scalar(const unsigned char *unenc, char *enc, size_t unenc_len) {
+  (void) unenc;
+  (void) enc;
+  (void) unenc_len;
+  return 0;
+}
+
+static size_t dec_scalar(const char *enc, unsigned char *dec, size_t enc_len) {
+  (void) enc;
+  (void) dec;
+  (void) enc_len;
+  return 0;
+}
+
+typedef size_t (*enc_kernel_fn)(const unsigned char *, char *, size_t);
+typedef size_t (*dec_kernel_fn)(const char *, unsigned char *, size_t);
+
+static const enc_kernel_fn enc_kernels[B64_KERNEL_COUNT] = {
+  enc_scalar,
+#ifdef B64_X86
+  enc_ssse3,
+  enc_avx2,
+#else
+  0,
+  0,
+#endif
+#ifdef B64_NEON
+  enc_neon
+#else
+  0
+#endif
+};
+
+static const dec_kernel_fn dec_kernels[B64_KERNEL_COUNT] = {
+  dec_scalar,
+#ifdef B64_X86
+  dec_ssse3,
+  dec_avx2,
+#else
+  0,
+  0,
+#endif
+#ifdef B64_NEON
+  dec_neon
+#else
+  0
+#endif
+};
+
+static const char *kernel_names[B64_KERNEL_COUNT] = {
+  "scalar", "ssse3", "avx2", "neon"
+};
+
+static int kernel = -1;
+
+// The kernel may be picked by several threads at once, e.g. the workers of
+// b64enc_parallel(). Any of the answers will do, so relaxed atomics are
+// enough to keep the access well defined.
+#if defined(__GNUC__)
+#define B64_KERNEL_LOAD() __atomic_load_n(&kernel, __ATOMIC_RELAXED)
+#define B64_KERNEL_STORE(k) __atomic_store_n(&kernel, (k), __ATOMIC_RELAXED)
+#else
+#define B64_KERNEL_LOAD() (kernel)
+#define B64_KERNEL_STORE(k) (kernel = (k))
+#endif
+
+// supported - whether the running CPU can execute a kernel. AArch64 always
+// has Advanced SIMD, so there is nothing to ask at runtime.
+static int supported(int k) {
+  if (k < 0 || k >= B64_KERNEL_COUNT || !enc_kernels[k]) return 0;
+#ifdef B64_X86
+  __builtin_cpu_init();
+  if (k == B64_KERNEL_SSSE3) return __builtin_cpu_supports("ssse3");
+  if (k == B64_KERNEL_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+  return 1;
+}
+
+int b64_kernel(void) {
+
+  int k = B64_KERNEL_LOAD();
+
+  // Pick the widest kernel on first use. Racing threads all arrive at the
+  // same answer, so there's no need for a lock.
+  if (k < 0) {
+    k = B64_KERNEL_COUNT - 1;
+    while (!supported(k)) k--;
+    B64_KERNEL_STORE(k);
+  }
+
+  return k;
+}
+
+int b64_set_kernel(int k) {
+  if (!supported(k)) return -1;
+  B64_KERNEL_STORE(k);
+  return 0;
+}
+
+const char *b64_kernel_name(int k) {
+  if (k < 0 || k >= B64_KERNEL_COUNT) return "unknown";
+  return kernel_names[k];
+}
+
+size_t b64enc_simd(const unsigned char *unenc, char *enc, size_t unenc_len) {
+  return enc_kernels[b64_kernel()](unenc, enc, unenc_len);
+}
+
+size_t b64dec_simd(const char *enc, unsigned char *dec, size_t enc_len) {
+  return dec_kernels[b64_kernel()](enc, dec, enc_len);
+}
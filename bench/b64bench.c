@@ -0,0 +1,244 @@
+/*
+ * Host benchmark for the base64 functions. Measures encode and decode
+ * throughput for payloads from 16 bytes to 16 MiB with every kernel the
+ * CPU supports, and latency for small messages of mixed length. Output
+ * follows the layout of Google Benchmark.
+ *
+ * Build from the top of the repository:
+ *   cc -O2 -pthread -I. bench/b64bench.c b64.c b64_simd.c b64_parallel.c -o b64bench
+ * Run:
+ *   ./b64bench [max_bytes] [min_seconds]
+ *
+ * Correctness is checked by tests/verify.c, not here.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <b64.h>
+#include "b64_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static unsigned long long cycles(void) { return __rdtsc(); }
+#else
+static unsigned long long cycles(void) { return 0; }
+#endif
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keeps the compiler from deciding the results are never used.
+static volatile int sink;
+
+typedef int (*bench_fn)(char *in, char *out, size_t len);
+
+static int run_enc(char *in, char *out, size_t len) {
+  return b64enc(in, out, len);
+}
+
+static int run_dec(char *in, char *out, size_t len) {
+  return b64dec(in, out, len);
+}
+
+static int run_enc_parallel(char *in, char *out, size_t len) {
+  return b64enc_parallel(in, out, len, 0);
+}
+
+static int run_dec_parallel(char *in, char *out, size_t len) {
+  return b64dec_parallel(in, out, len, 0);
+}
+
+// Decoding with a CRC-32 of the result, in two passes or fused through a
+// decoder hook.
+static uint32_t crc;
+
+static int run_dec_crc(char *in, char *out, size_t len) {
+  int dec_len = b64dec(in, out, len);
+  crc = b64_crc32(0, out, dec_len);
+  return dec_len;
+}
+
+static int run_dec_crc_hook(char *in, char *out, size_t len) {
+  b64dec_ctx ctx;
+  int dec_len;
+
+  crc = 0;
+  b64dec_init(&ctx);
+  b64dec_set_hook(&ctx, b64_crc32_hook, &crc);
+  dec_len = b64dec_update(&ctx, in, out, len);
+  if (b64dec_final(&ctx) != 0) return 0;
+  return dec_len;
+}
+
+// Small-message batches, as from an MQTT bridge: BATCH_COUNT messages of
+// 'len' bytes each, encoded one call at a time or with one batch call.
+#define BATCH_COUNT 1024
+static b64_span batch[BATCH_COUNT];
+static size_t batch_offsets[BATCH_COUNT + 1];
+
+static int run_enc_each(char *in, char *out, size_t len) {
+  int j = 0;
+  (void) in;
+  (void) len;
+  for (size_t k=0; k<BATCH_COUNT; k++) {
+    j += b64enc((char *) batch[k].ptr, out + j, batch[k].len) + 1;
+  }
+  return j;
+}
+
+static int run_enc_batch(char *in, char *out, size_t len) {
+  (void) in;
+  (void) len;
+  return b64enc_batch(batch, BATCH_COUNT, out, batch_offsets);
+}
+
+// Small messages of mixed lengths up to SMALL_MAX, as with tokens and
+// sensor readings, so the tail and padding handling can't be predicted
+// from one call to the next. Timed per message.
+#define SMALL_COUNT 256
+#define SMALL_MAX 64
+static b64_span small[SMALL_COUNT];
+static b64_span small_enc[SMALL_COUNT];
+static char small_buf[SMALL_COUNT][SMALL_MAX / 3 * 4 + 8];
+static size_t small_bytes;
+
+static int run_enc_small(char *in, char *out, size_t len) {
+  int j = 0;
+  (void) in;
+  (void) len;
+  for (size_t k=0; k<SMALL_COUNT; k++) j += b64enc_bytes(small[k].ptr, out, small[k].len);
+  return j;
+}
+
+static int run_dec_small(char *in, char *out, size_t len) {
+  int j = 0;
+  (void) in;
+  (void) len;
+  for (size_t k=0; k<SMALL_COUNT; k++) j += b64dec_bytes(small_enc[k].ptr, (uint8_t *) out, small_enc[k].len);
+  return j;
+}
+
+// bench_calls - call fn over the same buffers until min_time has passed,
+// doubling the iteration count each round like Google Benchmark does.
+// 'size' is the payload size shown in the label, 'bytes' the unencoded
+// data handled per call and 'calls' how many messages that is. Reports
+// time per message, throughput in MB/s of unencoded data, and cycles per
+// byte.
+static void bench_calls(const char *name, const char *kernel, size_t size, bench_fn fn,
+                        char *in, char *out, size_t len, size_t bytes, size_t calls, double min_time) {
+  unsigned long iters = 1;
+  double elapsed;
+  unsigned long long ticks;
+  char label[64];
+
+  for (;;) {
+    unsigned long long c0 = cycles();
+    double t0 = now();
+    for (unsigned long k=0; k<iters; k++) sink = fn(in, out, len);
+    elapsed = now() - t0;
+    ticks = cycles() - c0;
+    if (elapsed >= min_time) break;
+    iters *= 2;
+  }
+
+  snprintf(label, sizeof label, "%s/%s/%zu", name, kernel, size);
+  printf("%-32s %12.1f ns %12lu %10.1f MB/s", label,
+         elapsed * 1e9 / iters / calls, iters * calls, (double) bytes * iters / elapsed / 1e6);
+#ifdef HAVE_CYCLES
+  printf(" %8.3f cyc/B", (double) ticks / iters / bytes);
+#else
+  (void) ticks;
+#endif
+  printf("\n");
+}
+
+static void bench(const char *name, const char *kernel, size_t size, bench_fn fn,
+                  char *in, char *out, size_t len, size_t bytes, double min_time) {
+  bench_calls(name, kernel, size, fn, in, out, len, bytes, 1, min_time);
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_len = argc > 1 ? strtoul(argv[1], NULL, 0) : 16 << 20;
+  double min_time = argc > 2 ? atof(argv[2]) : 0.2;
+  char *unenc = malloc(max_len);
+  char *enc = malloc(b64enclen(max_len) + BATCH_COUNT * 4);  // Batches pad every message.
+  char *dec = malloc(max_len);
+
+  if (!unenc || !enc || !dec) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  srand(1);
+  for (size_t i=0; i<max_len; i++) unenc[i] = rand();
+  for (size_t k=0; k<SMALL_COUNT && (k + 1) * SMALL_MAX<=max_len; k++) {
+    small[k].ptr = unenc + k * SMALL_MAX;
+    small[k].len = 1 + rand() %SMALL_MAX;
+    small_bytes += small[k].len;
+  }
+
+  printf("%-32s %15s %12s %15s%s\n", "Benchmark", "Time", "Iterations", "Throughput",
+#ifdef HAVE_CYCLES
+         "  Cycles"
+#else
+         ""
+#endif
+         );
+  printf("------------------------------------------------------------------------------------\n");
+
+  for (int k=0; k<B64_KERNEL_COUNT; k++) {
+    if (b64_set_kernel(k) != 0) continue;
+
+    if (SMALL_COUNT * SMALL_MAX <= max_len) {
+      for (size_t m=0; m<SMALL_COUNT; m++) {
+        small_enc[m].ptr = small_buf[m];
+        small_enc[m].len = b64enc_bytes(small[m].ptr, small_buf[m], small[m].len);
+      }
+      bench_calls("b64enc_small", b64_kernel_name(k), SMALL_MAX, run_enc_small, unenc, enc, 0, small_bytes, SMALL_COUNT, min_time);
+      bench_calls("b64dec_small", b64_kernel_name(k), SMALL_MAX, run_dec_small, enc, dec, 0, small_bytes, SMALL_COUNT, min_time);
+    }
+
+    for (size_t len=16; len<=256 && len * BATCH_COUNT<=max_len; len*=4) {
+      for (size_t m=0; m<BATCH_COUNT; m++) {
+        batch[m].ptr = unenc + m * len;
+        batch[m].len = len;
+      }
+      bench("b64enc_each", b64_kernel_name(k), len, run_enc_each, unenc, enc, len, len * BATCH_COUNT, min_time);
+      bench("b64enc_batch", b64_kernel_name(k), len, run_enc_batch, unenc, enc, len, len * BATCH_COUNT, min_time);
+    }
+
+    for (size_t len=16; len<=max_len; len*=4) {
+      size_t enc_len = b64enclen(len);
+      b64enc(unenc, enc, len);
+
+      bench("b64enc", b64_kernel_name(k), len, run_enc, unenc, enc, len, len, min_time);
+      bench("b64dec", b64_kernel_name(k), len, run_dec, enc, dec, enc_len, len, min_time);
+
+      // Fusing only matters once the output no longer fits in cache.
+      if (len >= 1 << 16) {
+        bench("b64dec_crc32", b64_kernel_name(k), len, run_dec_crc, enc, dec, enc_len, len, min_time);
+        bench("b64dec_crc32_hook", b64_kernel_name(k), len, run_dec_crc_hook, enc, dec, enc_len, len, min_time);
+      }
+
+      // Splitting only pays off for big inputs.
+      if (len >= 1 << 20) {
+        bench("b64enc_parallel", b64_kernel_name(k), len, run_enc_parallel, unenc, enc, len, len, min_time);
+        bench("b64dec_parallel", b64_kernel_name(k), len, run_dec_parallel, enc, dec, enc_len, len, min_time);
+      }
+    }
+  }
+
+  free(unenc);
+  free(enc);
+  free(dec);
+
+  return 0;
+}
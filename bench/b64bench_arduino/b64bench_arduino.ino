@@ -0,0 +1,74 @@
+/*
+ * Benchmark sketch. Times b64enc() and b64dec() for payloads from 16 bytes
+ * up to MAX_LEN and prints throughput and cycles per byte to Serial.
+ * Cycle counts come from the CPU's cycle counter on ESP32; elsewhere they
+ * are estimated from micros() and F_CPU.
+ */
+
+#include <b64.h>
+
+#if defined(ESP32)
+#define MAX_LEN 16384
+#define CYCLES() ESP.getCycleCount()
+#else
+#define MAX_LEN 256
+#define CYCLES() ((uint32_t) (micros() * (F_CPU / 1000000UL)))
+#endif
+
+// Long enough that micros() resolution doesn't matter.
+#define MIN_MICROS 200000UL
+
+static char unenc[MAX_LEN];
+static char enc[(MAX_LEN + 2) / 3 * 4 + 1];
+static char dec[MAX_LEN];
+static volatile int sink;
+
+void report(const char *name, size_t len, unsigned long iters, unsigned long us, uint32_t cycles) {
+  Serial.print(name);
+  Serial.print("/");
+  Serial.print(len);
+  Serial.print("\t");
+  Serial.print((float) us / iters, 2);
+  Serial.print(" us\t");
+  Serial.print((float) len * iters / us, 3);
+  Serial.print(" MB/s\t");
+  Serial.print((float) cycles / iters / len, 2);
+  Serial.println(" cyc/B");
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  for (size_t i=0; i<sizeof unenc; i++) unenc[i] = random(256);
+
+  Serial.println("Benchmark\tTime\tThroughput\tCycles");
+  for (size_t len=16; len<=MAX_LEN; len*=4) {
+    size_t enc_len = b64enclen(len);
+    unsigned long iters;
+    unsigned long t0;
+    uint32_t c0;
+
+    iters = 0;
+    t0 = micros();
+    c0 = CYCLES();
+    while (micros() - t0 < MIN_MICROS) {
+      sink = b64enc(unenc, enc, len);
+      iters++;
+    }
+    report("b64enc", len, iters, micros() - t0, CYCLES() - c0);
+
+    iters = 0;
+    t0 = micros();
+    c0 = CYCLES();
+    while (micros() - t0 < MIN_MICROS) {
+      sink = b64dec(enc, dec, enc_len);
+      iters++;
+    }
+    report("b64dec", len, iters, micros() - t0, CYCLES() - c0);
+  }
+}
+
+void loop() {
+
+}
@@ -0,0 +1,57 @@
+/*
+ * Compile-time checks for b64.hpp. Everything here is a static_assert, so
+ * building this file is the test; a wrong answer fails the build. Needs
+ * C++20 for the string literal encode<>() and decode<>().
+ */
+
+#include <b64.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+constexpr bool same(const char *a, const char *b) {
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+template <std::size_t N>
+constexpr bool same(const std::array<std::uint8_t, N> &a, const char *b) {
+  for (std::size_t i = 0; i < N; i++) {
+    if (a[i] != static_cast<std::uint8_t>(b[i])) return false;
+  }
+  return b[N] == '\0';
+}
+
+// The RFC 4648 test vectors, padded.
+static_assert(same(b64::encode<"">().data(), ""));
+static_assert(same(b64::encode<"f">().data(), "Zg=="));
+static_assert(same(b64::encode<"fo">().data(), "Zm8="));
+static_assert(same(b64::encode<"foo">().data(), "Zm9v"));
+static_assert(same(b64::encode<"foobar">().data(), "Zm9vYmFy"));
+
+static_assert(same(b64::decode<"Zg==">(), "f"));
+static_assert(same(b64::decode<"Zm8=">(), "fo"));
+static_assert(same(b64::decode<"Zm9vYmFy">(), "foobar"));
+
+// base64url, unpadded, where the two alphabets differ.
+constexpr std::array<std::uint8_t, 3> odd = {0xFB, 0xFF, 0xBF};
+static_assert(same(b64::encode(odd).data(), "+/+/"));
+static_assert(same(b64::encode<b64::url_codec>(odd).data(), "-_-_"));
+static_assert(same(b64::encode<"fo", b64::url_codec>().data(), "Zm8"));
+static_assert(same(b64::decode<"Zm8", b64::url_codec>(), "fo"));
+static_assert(b64::decode<"-_-_", b64::url_codec>() == odd);
+
+// Sizes agree with what was produced.
+static_assert(b64::encode<"foobar">().size() == b64::encoded_size(6) + 1);
+static_assert(b64::decode<"Zm9vYg==">().size() == 4);
+
+}  // namespace
+
+int main() {
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Fuzz target for the decoders. The first byte of each input picks the
+ * decoder flags and where the streaming decoder splits the rest, which is
+ * decoded as base64 by b64dec_status(), b64dec_flags() and the streaming
+ * decoder. Besides not crashing or overrunning a buffer, they all have to
+ * agree on whether the input is valid and on the bytes it decodes to.
+ *
+ * Built with B64_BUILD_FUZZ. With Clang that's a libFuzzer binary:
+ *   ./b64fuzz corpus/
+ * With any other compiler, B64_FUZZ_MAIN adds a main() that runs each
+ * file named on the command line, or stdin, once, which suits AFL:
+ *   afl-fuzz -i seeds -o findings -- ./b64fuzz
+ */
+
+#include <b64.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "b64fuzz: %s\n", what);
+    abort();
+  }
+}
+
+// stream - decode in pieces of 1 to 'step' characters. Returns the number
+// of bytes, or -1 if the decoder rejected the input.
+static long stream(const char *enc, size_t len, uint8_t *dec, int flags, size_t step) {
+  b64dec_ctx ctx;
+  long n = 0;
+  int w;
+
+  b64dec_init_flags(&ctx, flags);
+  for (size_t i=0, k=0; i<len; k++) {
+    size_t c = 1 + (i * 31 + k) %step;
+    if (c > len - i) c = len - i;
+    if ((w = b64dec_update(&ctx, enc + i, (char *) dec + n, c)) < 0) {
+      b64dec_final(&ctx);
+      return -1;
+    }
+    n += w;
+    i += c;
+  }
+  if ((w = b64dec_final_bytes(&ctx, (char *) dec + n)) < 0) return -1;
+
+  return n + w;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static const int modes[] = {
+    0, B64_PAD_OPTIONAL, B64_PAD_NONE, B64_SKIPWS,
+    B64_SKIPWS | B64_PAD_OPTIONAL, B64_SKIPWS | B64_PAD_NONE
+  };
+  const char *enc = (const char *) data + 1;
+  size_t len, room, n, pos;
+  uint8_t *strict, *dec;
+  b64_status status;
+  long streamed;
+  int flags;
+
+  if (size == 0) return 0;
+  len = size - 1;
+  flags = modes[data[0] %6];
+
+  // No decoder writes more than this, whatever the flags, so anything
+  // beyond it is a real overrun.
+  room = b64dec_updatelen(len) + 3;
+  strict = malloc(room);
+  dec = malloc(room);
+  check(strict && dec, "out of memory");
+
+  status = b64dec_status(enc, (char *) strict, len, &n, &pos);
+  check(status == B64_OK || pos <= len, "b64dec_status error position past the end");
+  check(status != B64_OK || n <= b64declen_span(enc, len), "b64dec_status longer than b64declen_span");
+
+  // A NULL ends a chunk for the streaming decoder but not for the other
+  // two, so results are only compared without one.
+  if (!memchr(enc, '\0', len)) {
+    size_t got = b64dec_flags(enc, dec, len, 0);
+    check(got == (status == B64_OK ? n : 0) && memcmp(dec, strict, got) == 0, "b64dec_flags disagrees with b64dec_status");
+
+    streamed = stream(enc, len, dec, 0, 1 + data[0] / 6);
+    check((streamed >= 0) == (status == B64_OK), "streaming and b64dec_status disagree on validity");
+    check(streamed < 0 || ((size_t) streamed == n && memcmp(dec, strict, n) == 0), "streaming and b64dec_status disagree on bytes");
+
+    // Apart from B64_PAD_NONE, which refuses padding, the flags only ever
+    // let more through than strict decoding does.
+    streamed = stream(enc, len, strict, flags, 1 + data[0] / 6);
+    got = b64dec_flags(enc, dec, len, flags);
+    check(status != B64_OK || (flags & B64_PAD_NONE) || streamed >= 0, "flags rejected strict base64");
+    check(streamed < 0 ? got == 0 : got == (size_t) streamed && memcmp(dec, strict, got) == 0,
+          "b64dec_flags and streaming disagree");
+  }
+  else {
+    b64dec_flags(enc, dec, len, flags);
+    stream(enc, len, dec, flags, 1 + data[0] / 6);
+  }
+
+  free(strict);
+  free(dec);
+
+  return 0;
+}
+
+#ifdef B64_FUZZ_MAIN
+
+// run - feed one file, or stdin, to the target.
+static void run(FILE *f) {
+  static uint8_t buf[1 << 20];
+  size_t n = fread(buf, 1, sizeof buf, f);
+  LLVMFuzzerTestOneInput(buf, n);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) run(stdin);
+  for (int i=1; i<argc; i++) {
+    FILE *f = fopen(argv[i], "rb");
+    if (!f) {
+      perror(argv[i]);
+      return 1;
+    }
+    run(f);
+    fclose(f);
+  }
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Tests for the pipelined decoder: messages fed in random pieces through
+ * rings of random size, invalid input, and a NULL character inside the
+ * data, which has to fail the message rather than end it and leave the
+ * feeder waiting on a ring nobody reads. Exits non-zero on any failure.
+ */
+
+#include <b64.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+} collect;
+
+static unsigned long failures;
+
+static void sink(void *arg, const uint8_t *data, size_t len) {
+  collect *out = (collect *) arg;
+  memcpy(out->buf + out->len, data, len);
+  out->len += len;
+}
+
+static void check(int ok, const char *what) {
+  if (!ok && failures++ < 20) printf("FAIL %s\n", what);
+}
+
+// round_trip - encode 'len' random bytes and feed them back in random
+// pieces.
+static void round_trip(size_t len, size_t ring_len) {
+  uint8_t *in = malloc(len + 1);
+  char *enc = malloc(b64enclen(len));
+  collect out = { malloc(len + 3), 0 };
+  size_t enc_len, i;
+  b64dec_pipe *pipe;
+
+  for (i=0; i<len; i++) in[i] = rand();
+  enc_len = b64enc_bytes(in, enc, len);
+  pipe = b64dec_pipe_start(ring_len, 0, sink, &out, -1);
+  check(pipe != NULL, "b64dec_pipe_start");
+  if (pipe) {
+    int ok = 1;
+    for (i=0; i<enc_len; ) {
+      size_t n = 1 + rand() %7000;
+      if (n > enc_len - i) n = enc_len - i;
+      ok &= b64dec_pipe_feed(pipe, enc + i, n) == 0;
+      i += n;
+    }
+    ok &= b64dec_pipe_finish(pipe) == 0;
+    check(ok && out.len == len && memcmp(out.buf, in, len) == 0, "round trip");
+  }
+
+  free(in);
+  free(enc);
+  free(out.buf);
+}
+
+// invalid - feed 'enc' and then plenty more through a small ring, which
+// would hang if the decoder stopped reading. The message has to fail.
+static void invalid(const char *what, const char *enc, size_t enc_len) {
+  static char more[256];
+  uint8_t buf[512];
+  collect out = { buf, 0 };
+  b64dec_pipe *pipe = b64dec_pipe_start(64, 0, sink, &out, -1);
+
+  memset(more, 'A', sizeof more);
+  check(pipe != NULL, "b64dec_pipe_start");
+  if (!pipe) return;
+  b64dec_pipe_feed(pipe, enc, enc_len);
+  for (int k=0; k<4; k++) b64dec_pipe_feed(pipe, more, sizeof more);
+  check(b64dec_pipe_finish(pipe) == -1, what);
+}
+
+int main(void) {
+  srand(23);
+  for (int k=0; k<200; k++) round_trip(rand() %300000, k %3 ? 1 + rand() %5000 : 0);
+  round_trip(0, 0);
+
+  invalid("invalid character", "QUJD!!!!", 8);
+  invalid("NULL inside the data", "AAAA\0AAA", 8);
+  invalid("NULL at the end of a chunk", "AAAA\0", 5);
+
+  // Cut short, then padless with B64_SKIPWS line breaks.
+  {
+    uint8_t buf[8];
+    collect out = { buf, 0 };
+    b64dec_pipe *pipe = b64dec_pipe_start(0, 0, sink, &out, -1);
+    b64dec_pipe_feed(pipe, "QUJ", 3);
+    check(b64dec_pipe_finish(pipe) == -1, "truncated");
+
+    out.len = 0;
+    pipe = b64dec_pipe_start(0, B64_SKIPWS | B64_PAD_NONE, sink, &out, -1);
+    b64dec_pipe_feed(pipe, "QU\nJDRA\n", 8);
+    check(b64dec_pipe_finish(pipe) == 0 && out.len == 4 && memcmp(buf, "ABCD", 4) == 0, "padless");
+  }
+
+  printf("pipe: %lu failures\n", failures);
+  return failures != 0;
+}
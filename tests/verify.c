@@ -0,0 +1,351 @@
+/*
+ * Differential and property tests for the base64 functions. Every kernel
+ * the CPU supports, and the streaming, batch, scatter/gather, wrapping,
+ * in-place and parallel functions on top of it, is run over random input
+ * of 0 to 64 KiB at every alignment and compared with a reference encoder
+ * written one bit at a time. Streaming input is split at random points,
+ * so groups get cut part way through, and single-character corruptions
+ * have to be reported at the same position as the reference says.
+ *
+ * Run:
+ *   ./b64verify [iterations] [seed]
+ *
+ * Exits non-zero on any difference. A failing seed can be given again to
+ * reproduce it.
+ */
+
+#include <b64.h>
+#include "b64_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The reference works a bit at a time, so it shares no tables or
+// shortcuts with the code it checks.
+#define VERIFY_MAX 65536
+#define VERIFY_ALIGN 32
+#define VERIFY_ENC (VERIFY_MAX / 3 * 4 + 8)
+
+static const char ref_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint64_t rng_state = 1;
+static unsigned long failures;
+static unsigned long cases;
+
+// rng - xorshift64, so a failing seed can be run again anywhere.
+static uint32_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (uint32_t) (rng_state >> 16);
+}
+
+// ref_enc - encode with or without padding. Returns the number of
+// characters written, not counting the NULL terminator.
+static size_t ref_enc(const uint8_t *in, size_t len, char *out, int pad) {
+  size_t j = 0;
+  unsigned acc = 0;
+  int bits = 0;
+
+  for (size_t i=0; i<len; i++) {
+    for (int b=7; b>=0; b--) {
+      acc = acc << 1 | (in[i] >> b & 1);
+      if (++bits == 6) {
+        out[j++] = ref_alphabet[acc];
+        acc = 0;
+        bits = 0;
+      }
+    }
+  }
+  if (bits) out[j++] = ref_alphabet[acc << (6 - bits)];
+  while (pad && j %4) out[j++] = '=';
+  out[j] = '\0';
+
+  return j;
+}
+
+// ref_check - what b64dec_status() ought to say about strict, padded
+// base64 with no terminator.
+static b64_status ref_check(const char *enc, size_t len, size_t *err_pos) {
+  size_t padded = 0;
+
+  if (len %4) {
+    *err_pos = len - len %4;
+    return B64_ERR_TRUNC;
+  }
+  if (len > 0 && enc[len - 1] == '=') padded++;
+  if (padded && enc[len - 2] == '=') padded++;
+  for (size_t i=0; i<len - padded; i++) {
+    if (!memchr(ref_alphabet, enc[i], 64)) {
+      *err_pos = i;
+      return enc[i] == '=' ? B64_ERR_PAD : B64_ERR_CHAR;
+    }
+  }
+
+  return B64_OK;
+}
+
+static void fail(const char *what, int kernel, size_t len, size_t align) {
+  if (failures++ < 20) printf("FAIL %s/%s len %zu align %zu\n", what, b64_kernel_name(kernel), len, align);
+}
+
+// chunk - a random split for the streaming functions. Mostly short, so
+// groups are often cut part way through, and sometimes empty.
+static size_t chunk(size_t left) {
+  size_t n = rng() %2 ? rng() %8 : rng() %4096;
+  return n < left ? n : left;
+}
+
+// segment - cut 'len' bytes at 'base' into up to 'max' random segments for
+// the scatter/gather functions, some of them empty. Returns the count.
+static size_t segment(b64_iov *iov, size_t max, void *base, size_t len) {
+  size_t count = 1 + rng() %max;
+  size_t n = 0;
+
+  for (size_t k=0; k<count; k++) {
+    size_t c = k == count - 1 ? len - n : chunk(len - n);
+    iov[k].base = (char *) base + n;
+    iov[k].len = c;
+    n += c;
+  }
+
+  return count;
+}
+
+// verify_one - check one random input of 'len' bytes at offset 'align'.
+static void verify_one(int kernel, size_t len, size_t align) {
+  static uint8_t in_buf[VERIFY_MAX + VERIFY_ALIGN];
+  static uint8_t dec_buf[VERIFY_ENC * 2 + VERIFY_ALIGN];  // Room for b64dec_ws.
+  static const size_t lines[] = {4, 8, 64, 76};
+  static char enc_buf[VERIFY_ENC * 2 + VERIFY_ALIGN];  // Room for whitespace.
+  static char ref[VERIFY_ENC];
+  static char bare[VERIFY_ENC];
+  static b64_span spans[8];
+  static size_t offsets[9];
+  static b64_status statuses[8];
+  static b64_iov iov_in[16];
+  static b64_iov iov_out[16];
+  size_t in_count, out_count;
+  uint8_t *in = in_buf + align;
+  uint8_t *dec = dec_buf + rng() %VERIFY_ALIGN;
+  char *enc = enc_buf + rng() %VERIFY_ALIGN;
+  size_t ref_len, bare_len, n, i;
+  size_t pos, ref_pos;
+  b64_status status;
+  b64enc_ctx ectx;
+  b64dec_ctx dctx;
+  int ok;
+
+  cases++;
+  for (i=0; i<len; i++) in[i] = rng();
+  ref_len = ref_enc(in, len, ref, 1);
+  bare_len = ref_enc(in, len, bare, 0);
+
+  n = b64enc_bytes(in, enc, len);
+  if (n != ref_len || memcmp(enc, ref, ref_len + 1) != 0) fail("b64enc_bytes", kernel, len, align);
+
+  n = b64dec_bytes(ref, dec, ref_len);
+  if (n != len || memcmp(dec, in, len) != 0) fail("b64dec_bytes", kernel, len, align);
+
+  status = b64dec_status(ref, (char *) dec, ref_len + 1, &n, &pos);
+  if (status != B64_OK || n != len || memcmp(dec, in, len) != 0) fail("b64dec_status", kernel, len, align);
+
+  // Streaming, split at random.
+  b64enc_init(&ectx);
+  for (i=0, n=0; i<len; ) {
+    size_t c = chunk(len - i);
+    n += b64enc_update(&ectx, (const char *) in + i, enc + n, c);
+    i += c;
+  }
+  n += b64enc_final(&ectx, enc + n);
+  if (n != ref_len || memcmp(enc, ref, ref_len + 1) != 0) fail("b64enc_update", kernel, len, align);
+
+  b64dec_init(&dctx);
+  for (i=0, n=0, ok=1; ok && i<ref_len; ) {
+    size_t c = chunk(ref_len - i);
+    int w = b64dec_update(&dctx, ref + i, (char *) dec + n, c);
+    if (w < 0) ok = 0;
+    else n += w;
+    i += c;
+  }
+  if (!ok || b64dec_final(&dctx) != 0 || n != len || memcmp(dec, in, len) != 0) fail("b64dec_update", kernel, len, align);
+
+  // Padding modes, one-shot and streaming.
+  n = b64dec_flags(bare, dec, bare_len, B64_PAD_NONE);
+  if (n != len || b64declen_flags(bare, bare_len, B64_PAD_NONE) != len || memcmp(dec, in, len) != 0) {
+    fail("b64dec_flags/none", kernel, len, align);
+  }
+  n = b64dec_flags(bare, dec, bare_len, B64_PAD_OPTIONAL);
+  if (n != len || memcmp(dec, in, len) != 0) fail("b64dec_flags/optional", kernel, len, align);
+  n = b64dec_flags(ref, dec, ref_len, B64_PAD_OPTIONAL);
+  if (n != len || memcmp(dec, in, len) != 0) fail("b64dec_flags/optional", kernel, len, align);
+
+  b64dec_init_flags(&dctx, B64_PAD_NONE);
+  for (i=0, n=0, ok=1; ok && i<bare_len; ) {
+    size_t c = chunk(bare_len - i);
+    int w = b64dec_update(&dctx, bare + i, (char *) dec + n, c);
+    if (w < 0) ok = 0;
+    else n += w;
+    i += c;
+  }
+  if (ok) {
+    int w = b64dec_final_bytes(&dctx, (char *) dec + n);
+    if (w < 0) ok = 0;
+    else n += w;
+  }
+  if (!ok || n != len || memcmp(dec, in, len) != 0) fail("b64dec_final_bytes", kernel, len, align);
+
+  // Whitespace scattered through, as from a wrapped file.
+  for (i=0, n=0; i<ref_len; i++) {
+    if (rng() %16 == 0) enc[n++] = " \t\r\n"[rng() %4];
+    enc[n++] = ref[i];
+  }
+  n = b64dec_flags(enc, dec, n, B64_SKIPWS);
+  if (n != len || memcmp(dec, in, len) != 0) fail("b64dec_flags/skipws", kernel, len, align);
+
+  // One character changed, or the end cut off. The position and kind of
+  // error have to match the reference, and the streaming decoder has to
+  // agree on whether it's valid.
+  if (ref_len > 0) {
+    size_t enc_len = ref_len;
+    memcpy(enc, ref, ref_len);
+    if (rng() %4 == 0) enc_len -= 1 + rng() %3;
+    else enc[rng() %ref_len] = rng() %255 + 1;
+    status = ref_check(enc, enc_len, &ref_pos);
+    if (b64dec_status(enc, (char *) dec, enc_len, NULL, &pos) != status || (status != B64_OK && pos != ref_pos)) {
+      fail("b64dec_status/error", kernel, len, align);
+    }
+    b64dec_init(&dctx);
+    ok = b64dec_update(&dctx, enc, (char *) dec, enc_len) >= 0 && b64dec_final(&dctx) == 0;
+    if (ok != (status == B64_OK)) fail("b64dec_update/error", kernel, len, align);
+    b64dec_init(&dctx);
+    ok = b64dec_update_status(&dctx, enc, (char *) dec, enc_len, &n) == B64_OK && b64dec_final(&dctx) == 0;
+    if (ok != (status == B64_OK)) fail("b64dec_update_status/error", kernel, len, align);
+  }
+
+  // Scatter/gather, with both sides cut up at random. The result has to
+  // match the one-shot one.
+  in_count = segment(iov_in, 16, in, len);
+  out_count = segment(iov_out, 16, enc, ref_len);
+  n = b64enc_iov(iov_in, in_count, iov_out, out_count);
+  if (n != ref_len || memcmp(enc, ref, ref_len) != 0) fail("b64enc_iov", kernel, len, align);
+
+  in_count = segment(iov_in, 16, ref, ref_len);
+  out_count = segment(iov_out, 16, dec, len);
+  n = b64dec_iov(iov_in, in_count, iov_out, out_count, 0);
+  if (n != len || memcmp(dec, in, len) != 0) fail("b64dec_iov", kernel, len, align);
+
+  in_count = segment(iov_in, 16, bare, bare_len);
+  out_count = segment(iov_out, 16, dec, len);
+  n = b64dec_iov(iov_in, in_count, iov_out, out_count, B64_PAD_NONE);
+  if (n != len || memcmp(dec, in, len) != 0) fail("b64dec_iov/none", kernel, len, align);
+
+  // Wrapped into lines, then decoded straight back with the breaks in.
+  for (i=0; i<sizeof lines / sizeof lines[0]; i++) {
+    int flags = rng() %4;
+    n = b64enc_wrap((char *) in, enc, len, lines[i], flags);
+    if (n != b64enclen_wrap(len, lines[i], flags) - 1) fail("b64enc_wrap", kernel, len, align);
+    if (b64dec_ws(enc, (char *) dec, n) != len || memcmp(dec, in, len) != 0) {
+      fail("b64enc_wrap/b64dec_ws", kernel, len, align);
+    }
+  }
+
+  // A few messages cut from the input, as one batch each way.
+  size_t count = 1 + rng() %8;
+  for (i=0, n=0; i<count; i++) {
+    size_t c = i == count - 1 ? len - n : chunk(len - n);
+    spans[i].ptr = in + n;
+    spans[i].len = c;
+    n += c;
+  }
+  n = b64enc_batch(spans, count, enc, offsets);
+  ok = n == b64enclen_batch(spans, count, NULL);
+  for (i=0; ok && i<count; i++) {
+    size_t c = ref_enc(spans[i].ptr, spans[i].len, bare, 1);
+    ok = offsets[i + 1] - offsets[i] == c + 1 && memcmp(enc + offsets[i], bare, c + 1) == 0;
+  }
+  if (!ok) fail("b64enc_batch", kernel, len, align);
+  for (i=0; i<count; i++) {
+    spans[i].ptr = enc + offsets[i];
+    spans[i].len = offsets[i + 1] - offsets[i];
+  }
+  if (b64dec_batch(spans, count, dec, offsets) != 0 || offsets[count] != len || memcmp(dec, in, len) != 0) {
+    fail("b64dec_batch", kernel, len, align);
+  }
+
+  // One message spoiled, with no offsets asked for. Only that one fails,
+  // empty messages included.
+  size_t bad = rng() %count;
+  ((char *) spans[bad].ptr)[0] = '!';
+  ok = b64dec_batch_status(spans, count, dec, NULL, statuses) == 1;
+  for (i=0; ok && i<count; i++) ok = (statuses[i] == B64_OK) == (i != bad);
+  if (!ok) fail("b64dec_batch_status", kernel, len, align);
+
+  // In place.
+  memcpy(enc, in, len);
+  n = b64enc_inplace(enc, len);
+  if (n != ref_len || memcmp(enc, ref, ref_len + 1) != 0) fail("b64enc_inplace", kernel, len, align);
+  n = b64dec_inplace(enc, ref_len + 1);
+  if (n != len || memcmp(enc, in, len) != 0) fail("b64dec_inplace", kernel, len, align);
+}
+
+// verify_parallel - inputs big enough for the parallel functions to split.
+static void verify_parallel(int kernel, size_t len) {
+  uint8_t *in = malloc(len);
+  uint8_t *dec = malloc(len);
+  char *ref = malloc(b64enclen(len));
+  char *enc = malloc(b64enclen(len));
+  size_t ref_len;
+  int threads = 2 + rng() %7;
+
+  if (!in || !dec || !ref || !enc) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  cases++;
+  for (size_t i=0; i<len; i++) in[i] = rng();
+  ref_len = ref_enc(in, len, ref, 1);
+  if (b64enc_parallel((char *) in, enc, len, threads) != ref_len || memcmp(enc, ref, ref_len + 1) != 0) {
+    fail("b64enc_parallel", kernel, len, 0);
+  }
+  if (b64dec_parallel(ref, (char *) dec, ref_len + 1, threads) != len || memcmp(dec, in, len) != 0) {
+    fail("b64dec_parallel", kernel, len, 0);
+  }
+
+  free(in);
+  free(dec);
+  free(ref);
+  free(enc);
+}
+
+// verify - every short length at every alignment, then 'iters' random
+// lengths and a few parallel-sized inputs. Returns the number of failures.
+static unsigned long verify(int kernel, unsigned long iters) {
+  unsigned long before = failures;
+
+  for (size_t len=0; len<=256; len++) {
+    for (size_t align=0; align<VERIFY_ALIGN; align++) verify_one(kernel, len, align);
+  }
+  for (unsigned long k=0; k<iters; k++) {
+    size_t len = rng() %2 ? rng() %(VERIFY_MAX + 1) : rng() %1024;
+    verify_one(kernel, len, rng() %VERIFY_ALIGN);
+  }
+  for (unsigned long k=0; k<iters / 256; k++) verify_parallel(kernel, (1 << 20) + rng() %(1 << 20));
+
+  return failures - before;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long iters = argc > 1 ? strtoul(argv[1], NULL, 0) : 4096;
+
+  if (argc > 2) rng_state = strtoull(argv[2], NULL, 0) | 1;
+  for (int k=0; k<B64_KERNEL_COUNT; k++) {
+    if (b64_set_kernel(k) != 0) continue;
+    cases = 0;
+    unsigned long n = verify(k, iters);
+    printf("verify/%-10s %10lu cases %6lu failures\n", b64_kernel_name(k), cases, n);
+  }
+
+  return failures != 0;
+}
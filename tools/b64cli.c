@@ -0,0 +1,256 @@
+/*
+  base64 functions for turning binary data into strings and back again.
+  Created April 2021 - David Horton and released to public domain.
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * Command line encoder and decoder for POSIX hosts, built as 'b64' by
+ * CMake. Regular files are memory mapped, input and output both, and the
+ * parallel kernels run straight over the mapped pages, so nothing is
+ * copied through a userspace buffer. '-' reads stdin or writes stdout
+ * instead, through the streaming functions.
+ *
+ *   b64 [-d] [-j threads] input output
+ *
+ * Output has no line breaks. Decoding accepts input broken into lines, as
+ * from base64(1), but takes a slower, single-threaded path for it.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <b64.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STREAM_BUFFER - read size when input or output can't be mapped.
+#define STREAM_BUFFER 65536
+
+static const char *prog = "b64";
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [-d] [-j threads] input output\n", prog);
+  fprintf(stderr, "  -d          decode instead of encode\n");
+  fprintf(stderr, "  -j threads  most threads to use (default: one per core)\n");
+  fprintf(stderr, "  input and output may be '-' for stdin and stdout\n");
+  exit(2);
+}
+
+static int fail(const char *what, const char *path) {
+  fprintf(stderr, "%s: %s: %s\n", prog, path, what ? what : strerror(errno));
+  return 1;
+}
+
+// map_input - map a whole file for reading, with a hint that it will be
+// read front to back. Returns NULL for a file that can't be mapped, such
+// as a pipe, leaving *len at its size.
+static char *map_input(int fd, size_t *len) {
+  struct stat st;
+  void *p;
+
+  *len = 0;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return NULL;
+  *len = (size_t) st.st_size;
+  p = mmap(NULL, *len, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) return NULL;
+  madvise(p, *len, MADV_SEQUENTIAL);
+  madvise(p, *len, MADV_WILLNEED);
+  return p;
+}
+
+// map_output - size a file and map it for writing. One byte more than
+// needed is mapped, for the NULL terminator b64enc_parallel() writes, and
+// trimmed off again by unmap_output().
+static char *map_output(int fd, size_t len) {
+  void *p;
+
+  if (ftruncate(fd, (off_t) len + 1) != 0) return NULL;
+  p = mmap(NULL, len + 1, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+  madvise(p, len + 1, MADV_HUGEPAGE);
+#endif
+  return p;
+}
+
+static int unmap_output(int fd, char *p, size_t mapped, size_t len) {
+  munmap(p, mapped + 1);
+  return ftruncate(fd, (off_t) len);
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    buf += n;
+    len -= (size_t) n;
+  }
+  return 0;
+}
+
+// encode_mapped - encode with the work spread over the cores.
+static void encode_mapped(char *in, size_t len, char *out, int threads) {
+  b64enc_parallel(in, out, len, threads);
+}
+
+// decode_mapped - decode with the work spread over the cores. Returns the
+// number of bytes written, or 0 if the input isn't strict base64 (which
+// includes having line breaks.) len has had any trailing newline taken off
+// already.
+static size_t decode_mapped(char *in, size_t len, char *out, int threads) {
+
+  // The input is cut short of the terminator b64dec_parallel() expects,
+  // but it only counts it off the length and never reads it.
+  return b64dec_parallel(in, out, len + 1, threads);
+}
+
+// decode_lines - decode on one thread, skipping whitespace. Returns the
+// number of bytes written, or -1 for invalid input.
+static long long decode_lines(const char *in, size_t len, char *out) {
+  b64dec_ctx ctx;
+  size_t n;
+
+  b64dec_init_flags(&ctx, B64_SKIPWS);
+  if (b64dec_update_status(&ctx, in, out, len, &n) != B64_OK) return -1;
+  if (b64dec_final(&ctx) != 0) return -1;
+
+  return (long long) n;
+}
+
+// encode_stream and decode_stream - the fallback when either end is a
+// pipe or terminal. Memory use is fixed, whatever the size of the input.
+// Return 0, 1 for invalid base64, -1 if reading failed or -2 if writing
+// failed.
+static int encode_stream(int in, int out) {
+  static char buf[STREAM_BUFFER];
+  static char enc[STREAM_BUFFER / 3 * 4 + 8];
+  b64enc_ctx ctx;
+  ssize_t n;
+
+  b64enc_init(&ctx);
+  while ((n = read(in, buf, sizeof buf)) != 0) {
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -1;
+    if (write_all(out, enc, b64enc_update(&ctx, buf, enc, (size_t) n)) != 0) return -2;
+  }
+  return write_all(out, enc, b64enc_final(&ctx, enc)) != 0 ? -2 : 0;
+}
+
+static int decode_stream(int in, int out) {
+  static char buf[STREAM_BUFFER];
+  static char dec[STREAM_BUFFER / 4 * 3 + 3];
+  b64dec_ctx ctx;
+  ssize_t n;
+
+  b64dec_init_flags(&ctx, B64_SKIPWS);
+  while ((n = read(in, buf, sizeof buf)) != 0) {
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -1;
+    int written = b64dec_update(&ctx, buf, dec, (size_t) n);
+    if (written < 0) return 1;
+    if (write_all(out, dec, (size_t) written) != 0) return -2;
+  }
+  return b64dec_final(&ctx) != 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  int decode = 0;
+  int threads = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "dj:h")) != -1) {
+    switch (opt) {
+      case 'd':
+        decode = 1;
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (argc - optind != 2) usage();
+
+  const char *in_path = strcmp(argv[optind], "-") == 0 ? "stdin" : argv[optind];
+  const char *out_path = strcmp(argv[optind + 1], "-") == 0 ? "stdout" : argv[optind + 1];
+  int in = strcmp(argv[optind], "-") == 0 ? STDIN_FILENO : open(in_path, O_RDONLY);
+  if (in < 0) return fail(NULL, in_path);
+  int out = strcmp(argv[optind + 1], "-") == 0 ? STDOUT_FILENO : open(out_path, O_RDWR | O_CREAT, 0666);
+  if (out < 0) return fail(NULL, out_path);
+
+  // Writing over the input would truncate it before a byte was read, so
+  // the output is only emptied once it's known to be a different file.
+  struct stat in_st, st;
+  if (fstat(in, &in_st) != 0) return fail(NULL, in_path);
+  if (fstat(out, &st) != 0) return fail(NULL, out_path);
+  if (S_ISREG(st.st_mode) && in_st.st_dev == st.st_dev && in_st.st_ino == st.st_ino) {
+    return fail("is the input file", out_path);
+  }
+  if (out != STDOUT_FILENO && S_ISREG(st.st_mode) && ftruncate(out, 0) != 0) return fail(NULL, out_path);
+
+  size_t len;
+  char *src = map_input(in, &len);
+  // Only a named output is mapped. Mapping writes from offset 0, which
+  // would overwrite a file stdout was opened on for appending.
+  int mappable = out != STDOUT_FILENO && S_ISREG(st.st_mode);
+
+  // Empty input is empty output, and there's nothing to map.
+  if (!src && len == 0 && mappable && S_ISREG(in_st.st_mode)) return 0;
+
+  if (!src || !mappable) {
+    int rc;
+
+    if (src) munmap(src, len);
+    rc = decode ? decode_stream(in, out) : encode_stream(in, out);
+    if (rc == -1) return fail(NULL, in_path);
+    if (rc < 0) return fail(NULL, out_path);
+    if (rc > 0) return fail("invalid base64", in_path);
+    return 0;
+  }
+
+  if (!decode) {
+    size_t enc_len = b64enclen(len) - 1;
+    char *dst = map_output(out, enc_len);
+    if (!dst) return fail(NULL, out_path);
+    encode_mapped(src, len, dst, threads);
+    if (unmap_output(out, dst, enc_len, enc_len) != 0) return fail(NULL, out_path);
+    return 0;
+  }
+
+  // A file written by another tool usually ends with a newline, which
+  // strict decoding would refuse.
+  size_t enc_len = len;
+  while (enc_len > 0 && (src[enc_len - 1] == '\n' || src[enc_len - 1] == '\r')) enc_len--;
+
+  size_t dec_max = b64dec_updatelen(enc_len);
+  char *dst = map_output(out, dec_max);
+  if (!dst) return fail(NULL, out_path);
+
+  long long dec_len = 0;
+  if (enc_len > 0) {
+    dec_len = (long long) decode_mapped(src, enc_len, dst, threads);
+    if (dec_len == 0) dec_len = decode_lines(src, enc_len, dst);
+  }
+  if (unmap_output(out, dst, dec_max, dec_len > 0 ? (size_t) dec_len : 0) != 0) return fail(NULL, out_path);
+  if (dec_len < 0) return fail("invalid base64", in_path);
+
+  return 0;
+}